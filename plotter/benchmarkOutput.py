@@ -0,0 +1,44 @@
+"""
+Compare CaloX output files written with different outputFormat/outputSchema
+settings: file size and RDataFrame read throughput of an optics-style and a
+truth-hit-style query. Write time is printed by the sim at the end of the job
+("CaloTree::EndJob: ... fill ... s").
+
+python benchmarkOutput.py mc_ttree.root mc_rntuple.root [more files]
+"""
+import os
+import sys
+import time
+import ROOT
+
+ROOT.gROOT.SetBatch(True)
+nThreads = int(os.environ.get("NTHREADS", "8"))
+if nThreads > 0:
+    ROOT.ROOT.EnableImplicitMT(nThreads)
+
+
+def readThroughput(fname):
+    # RDataFrame picks the TTree or RNTuple named "tree" by itself
+    rdf = ROOT.RDataFrame("tree", fname)
+    columns = [str(c) for c in rdf.GetColumnNames()]
+    results = [rdf.Count()]
+    if "OP_pos_final_z" in columns:
+        r = rdf.Define("OP_passEnd", "OP_pos_final_z > 49.0") \
+               .Define("OP_time_delta", "OP_time_final - OP_time_produced")
+        results.append(r.Histo1D(("op_dt", "op_dt", 100, 0, 20), "OP_time_delta", "OP_passEnd"))
+    if "truthhit_z" in columns:
+        results.append(rdf.Histo2D(("th_zt", "th_zt", 100, -100, 100, 50, 0, 20),
+                                   "truthhit_z", "truthhit_globaltime", "truthhit_edep"))
+
+    start = time.perf_counter()
+    ROOT.RDF.RunGraphs(results)
+    elapsed = time.perf_counter() - start
+    return results[0].GetValue(), elapsed
+
+
+print(f"{'file':40s} {'MB':>8s} {'events':>8s} {'read s':>8s} {'evt/s':>10s}")
+for fname in sys.argv[1:]:
+    size = os.path.getsize(fname) / 1024.0 / 1024.0
+    nevt, elapsed = readThroughput(fname)
+    rate = nevt / elapsed if elapsed > 0 else 0.0
+    print(f"{os.path.basename(fname):40s} {size:8.1f} {nevt:8d} {elapsed:8.2f} {rate:10.1f}")
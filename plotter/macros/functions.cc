@@ -72,4 +72,25 @@ RVec<double> SinTheta(const RVec<double> &x0, const RVec<double> &y0, const RVec
     }
 
     return result;
-}
\ No newline at end of file
+}
+// OP_flags of the compact output schema (see OPFlags in sim/include/CaloTree.h).
+// bit: 0=isCerenkov 1=isScintillation 2=isCoreC 3=isCoreS 4=isCladC 5=isCladS
+RVec<bool> OPFlag(const RVec<unsigned int> &flags, int bit)
+{
+    RVec<bool> result(flags.size());
+    for (size_t i = 0; i < flags.size(); ++i)
+        result[i] = (flags[i] >> bit) & 1u;
+    return result;
+}
+
+// shift: 8=productionFiber 12=finalFiber. -99 for photons not in a fiber.
+RVec<int> OPFiber(const RVec<unsigned int> &flags, int shift)
+{
+    RVec<int> result(flags.size());
+    for (size_t i = 0; i < flags.size(); ++i)
+    {
+        int f = (flags[i] >> shift) & 0xf;
+        result[i] = f == 0 ? -99 : f - 1;
+    }
+    return result;
+}
@@ -0,0 +1,137 @@
+// build one global event catalog (CaloEventCatalog.h) for a campaign:
+// the catalogs written by the jobs (eventCatalog true) are concatenated,
+// and ROOT outputs without one are scanned (no seeds then).
+//
+//   ./caloCatalog campaign.cxc run*/mc_*_catalog.cxc old/mc_*.root
+//   ./caloCatalog -q campaign.cxc 123456   (print event 123456)
+//
+// File names of the job catalogs are relative to the job directory; they
+// are stored relative to the directory caloCatalog runs in.
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "CaloEventCatalog.h"
+
+using namespace std;
+
+namespace
+{
+  string directoryOf(const string &path)
+  {
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? string() : path.substr(0, slash + 1);
+  }
+
+  bool endsWith(const string &s, const string &tail)
+  {
+    return s.size() >= tail.size() && s.compare(s.size() - tail.size(), tail.size(), tail) == 0;
+  }
+
+  // append the events of a job catalog.
+  bool appendCatalog(CaloCatalogWriter &out, const string &path)
+  {
+    CaloEventCatalog in(path);
+    if (!in.good())
+      return false;
+    string dir = directoryOf(path);
+    vector<int> fileMap;
+    for (int i = 0; i < in.nFiles(); i++)
+    {
+      const string &name = in.file(i);
+      fileMap.push_back(out.addFile(name[0] == '/' ? name : dir + name));
+    }
+    CaloCatalogRecord rec;
+    for (long i = 0; i < in.size(); i++)
+    {
+      if (!in.get(i, rec))
+        return false;
+      rec.file = fileMap[rec.file];
+      out.add(rec);
+    }
+    return true;
+  }
+
+  // append the events in the tree of a ROOT output.
+  bool appendTree(CaloCatalogWriter &out, const string &path)
+  {
+    TFile *f = TFile::Open(path.c_str());
+    if (!f || f->IsZombie())
+      return false;
+    TTree *t = f->Get<TTree>("tree");
+    if (!t)
+    {
+      f->Close();
+      return false;
+    }
+    CaloCatalogRecord rec = {};
+    rec.file = out.addFile(path);
+    t->SetBranchStatus("*", 0);
+    for (const char *name : {"run", "event", "beamID", "beamE", "beamX", "beamY", "beamZ"})
+      t->SetBranchStatus(name, 1);
+    t->SetBranchAddress("run", &rec.run);
+    t->SetBranchAddress("event", &rec.event);
+    t->SetBranchAddress("beamID", &rec.beamID);
+    t->SetBranchAddress("beamE", &rec.beamE);
+    t->SetBranchAddress("beamX", &rec.beamX);
+    t->SetBranchAddress("beamY", &rec.beamY);
+    t->SetBranchAddress("beamZ", &rec.beamZ);
+    for (Long64_t i = 0; i < t->GetEntries(); i++)
+    {
+      t->GetEntry(i);
+      rec.entry = i;
+      out.add(rec);
+    }
+    f->Close();
+    delete f;
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc == 4 && string(argv[1]) == "-q")
+  {
+    CaloEventCatalog cat(argv[2]);
+    CaloCatalogRecord rec;
+    if (!cat.get(atol(argv[3]), rec))
+    {
+      cout << "caloCatalog: no event " << argv[3] << " in " << argv[2] << " (" << cat.size()
+           << " events)" << endl;
+      return 1;
+    }
+    cout << cat.file(rec.file) << "  entry " << rec.entry << "  run " << rec.run << "  event "
+         << rec.event << "  seeds " << rec.seeds[0] << " " << rec.seeds[1] << "  beam " << rec.beamID
+         << " " << rec.beamE << " MeV at (" << rec.beamX << ", " << rec.beamY << ", " << rec.beamZ
+         << ") mm" << endl;
+    return 0;
+  }
+  if (argc < 3)
+  {
+    cout << "usage: " << argv[0] << " campaign.cxc job_catalog.cxc|output.root ..." << endl;
+    cout << "       " << argv[0] << " -q campaign.cxc globalIndex" << endl;
+    return 1;
+  }
+
+  CaloCatalogWriter out(argv[1]);
+  int nBad = 0;
+  for (int i = 2; i < argc; i++)
+  {
+    string in = argv[i];
+    bool ok = endsWith(in, ".root") ? appendTree(out, in) : appendCatalog(out, in);
+    if (!ok)
+    {
+      cout << "caloCatalog: skipped " << in << endl;
+      nBad++;
+    }
+  }
+  out.close();
+  cout << "caloCatalog: " << argv[1] << ": " << out.size() << " events from " << (argc - 2 - nBad)
+       << " inputs, " << nBad << " skipped" << endl;
+  return nBad ? 1 : 0;
+}
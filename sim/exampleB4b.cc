@@ -36,6 +36,7 @@
 #include "QBBC.hh"
 #include "G4EmStandardPhysics_option4.hh"
 #include "G4OpticalPhysics.hh"
+#include "G4ParallelWorldPhysics.hh"
 // #include "G4Cerenkov.hh"
 #include "Randomize.hh"
 
@@ -53,6 +54,7 @@
 
 #include "CaloTree.h"
 #include "B4bPhysicsList.hh"
+#include "CaloPhysicsCache.h"
 
 #
 using namespace std;
@@ -121,6 +123,8 @@ int main(int argc, char **argv)
   G4Random::setTheSeeds(seeds);
   G4Random::showEngineStatus();
   std::cout << "seeds[0]=" << seeds[0] << "   seeds[1]=" << seeds[1] << std::endl;
+  histo->setRunSeeds(seeds[0], seeds[1]);
+  histo->resumeEngine(); // -resume true: engine of the last checkpoint
 
   // Construct a serial run manager
   //
@@ -144,6 +148,10 @@ int main(int argc, char **argv)
   G4OpticalPhysics *opticalPhysics = new G4OpticalPhysics();
   physicsList->RegisterPhysics(opticalPhysics);
 
+  // navigation in the readout world (readoutWorld true), no materials
+  if (detector->GetReadoutWorld())
+    physicsList->RegisterPhysics(new G4ParallelWorldPhysics("ReadoutWorld"));
+
   runManager->SetUserInitialization(physicsList);
 
   // G4Cerenkov* theCerenkovProcess=new G4Cerenkov("Cerenkov");
@@ -157,12 +165,21 @@ int main(int argc, char **argv)
 
   auto run_action = new B4bRunAction(histo);
   runManager->SetUserAction(run_action);
+
+  // physics tables shared by the jobs of a campaign (batch jobs only)
+  CaloPhysicsCache *physicsCache = nullptr;
+  if (batchJob && histo->getParamS("physicsTableCache") != "none")
+  {
+    physicsCache = new CaloPhysicsCache(histo->getParamS("physicsTableCache"), "QGSP_BERT+G4OpticalPhysics");
+    run_action->setPhysicsCache(physicsCache);
+  }
   //
   auto event_action = new B4bEventAction(detector, gen_action, histo);
   runManager->SetUserAction(event_action);
   //
-  auto stepping_action = new B4bSteppingAction(event_action, histo);
+  auto stepping_action = new B4bSteppingAction(event_action, detector, histo);
   runManager->SetUserAction(stepping_action);
+  run_action->setSteppingAction(stepping_action);
 
   // runManager->SetNumberOfThreads(4);
   runManager->Initialize();
@@ -226,9 +243,13 @@ int main(int argc, char **argv)
     // UImanager->ApplyCommand(command);;
 
     // string evtmax="100";
-    command = "/run/beamOn " + histo->getParamS("numberOfEvents");
+    if (physicsCache)
+      physicsCache->prepare(physicsList); // after the macro: it may set cuts
+    command = "/run/beamOn " + std::to_string(histo->eventsToRun());
     cout << "command: " << command << endl;
     UImanager->ApplyCommand(command);
+    if (physicsCache)
+      physicsCache->store(physicsList);
   }
   else
   {
@@ -251,6 +272,7 @@ int main(int argc, char **argv)
   // in the main() program !
 
   delete visManager;
+  delete physicsCache;
   delete histo;
   delete runManager;
 }
@@ -33,9 +33,15 @@
 #include "G4VUserDetectorConstruction.hh"
 #include "globals.hh"
 
+#include <vector>
+
+#include "CaloLattice.h"
+
 class G4VPhysicalVolume;
+class B4ReadoutWorld;
 class G4GlobalMagFieldMessenger;
 class G4MaterialPropertiesTable;
+class G4Material;
 
 class CaloTree;
 
@@ -68,12 +74,46 @@ public:
   //
   const G4VPhysicalVolume *GetAbsorberPV() const;
   const G4VPhysicalVolume *GetGapPV() const;
+  const CaloLattice &GetLattice() const { return fLattice; }
+  G4bool IsHybrid() const { return fHybrid; }
+  const G4int *GetDetailWindow() const { return fWindow; } // hybrid: rodMin, rodMax, layerMin, layerMax
+  B4ReadoutWorld *GetReadoutWorld() const { return fReadout; } // nullptr: no readoutWorld
+
+  // a homogenized rod (detailWindow) by the caloType of the parts of a
+  // detailed one: 0 hole and claddings, 1 rod, 2 S cores, 3 C cores.
+  struct RodMix
+  {
+    G4double massShare[4] = {0., 0., 0., 0.}; // of an energy deposit
+    G4double areaShare[4] = {0., 0., 0., 0.}; // of a path along the rod
+    const G4Material *coreS = nullptr;
+    const G4Material *coreC = nullptr;
+  };
+  const RodMix &GetRodMix() const { return fRodMix; } // set by Construct()
 
 private:
   // methods
   //
   void DefineMaterials();
   G4VPhysicalVolume *DefineVolumes();
+  void SetVisAttributes();
+  void CheckAllOverlaps();
+
+  // cross section of a detailed rod, from its logical volumes
+  struct RodPart
+  {
+    G4Material *material;
+    G4double area;
+    G4int caloType;
+  };
+  std::vector<RodPart> RodParts() const;
+  void SetRodMix();
+
+  // GDML snapshot of the built geometry (geometryCacheDir), keyed by a
+  // hash of GeometrySignature().
+  G4String GeometrySignature();
+  G4String GeometryCacheFile();
+  G4VPhysicalVolume *ReadGeometryCache(const G4String &fileName);
+  void WriteGeometryCache(const G4String &fileName, G4VPhysicalVolume *world);
 
   // data members
   //
@@ -81,6 +121,14 @@ private:
   // magnetic field messenger
 
   G4bool fCheckOverlaps; // option to activate checking of volumes overlaps
+  G4String fCacheDir;    // geometry snapshots, empty: no cache
+  G4bool fValidate;      // geometryCheck: build and check all placements
+  G4String fNavigation;  // geometryNavigation: replica or parameterised
+  CaloLattice fLattice;  // rod and fiber positions
+  G4bool fHybrid;        // detailWindow: homogenized outside the window
+  G4int fWindow[4];      // rodMin, rodMax, layerMin, layerMax
+  RodMix fRodMix;        // hybrid: shares of the homogenized rods
+  B4ReadoutWorld *fReadout; // parallel readout world, owned by G4
 
   // G4MaterialPropertiesTable* fWorldMPT;
 };
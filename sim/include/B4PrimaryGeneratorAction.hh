@@ -35,16 +35,20 @@
 
 #include "G4ParticleGun.hh"
 #include "B4DetectorConstruction.hh"
+#include "CaloPythiaGenerator.h"
 
 #include <stdlib.h> /* getenv */
+#include <vector>
 
-class TFile;
+class TChain;
 class Py8Jet;
 
 class G4ParticleGun;
 class G4Event;
 
 class CaloTree;
+class CaloBeamSampler;
+class G4PrimaryVertex;
 
 /// The primary generator action class with particle gum.
 ///
@@ -79,24 +83,38 @@ private:
 
   G4ParticleTable *particleTable;
 
-  double worldZHalfLength;
+  double worldZHalfLength; // from the lattice, once
+
+  // single-particle beam, resolved once from the gun_* and beam* parameters
+  G4ParticleDefinition *gunParticle;
+  G4String gunParticleName;
+  CaloBeamSampler *beamSampler;
+  std::vector<double> beamDraws; // flat random numbers of one event
   void getPy8Event(G4Event *event);
+  void getPythiaEvent(G4Event *event);
+  G4PrimaryVertex *pythiaVertex();
   void printPy8Event();
 
   // parameters from env. variables
   void getParamFromEnvVars();
-  int CaloXPythiaON;                       //  0=singl particle gun, 1=Pythia8 Root file.
+  int CaloXPythiaON;                       //  0=singl particle gun, 1=Pythia8 Root file, 2=Pythia8 in the job.
   double CaloXPythiaXmin, CaloXPythiaXmax; //  vertex point smearing.
   double CaloXPythiaYmin, CaloXPythiaYmax;
   double CaloXPythiaZmin, CaloXPythiaZmax;
   int CaloXPythiaSkip;  //  number of events to skip
   int CaloXPythiaPrint; //  number of events to print
-  std::string CaloXPythiaFile;
+  std::string CaloXPythiaFile; //  file, glob, comma separated list or .txt/.list of them
+  int CaloXPythiaCacheMB;       //  TTreeCache size, 0=off
+  int CaloXPythiaPrefetch;      //  1=asynchronous read-ahead
+  std::string CaloXPythiaCard;  //  Pythia8 card file of CaloXPythiaON=2
 
-  TFile *finPy8;
+  TChain *py8chain;
   Py8Jet *py8evt;
   int py8eventCounter;
   int py8eventNumber;
+
+  CaloPythiaGenerator *pythiaGenerator;
+  std::vector<CaloPythiaGenerator::Particle> pythiaParticles; // of the current event
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,65 @@
+/// \file B4ReadoutWorld.hh
+/// \brief Definition of the B4ReadoutWorld class
+
+#ifndef B4ReadoutWorld_h
+#define B4ReadoutWorld_h 1
+
+#include "G4VUserParallelWorld.hh"
+#include "G4VSensitiveDetector.hh"
+#include "globals.hh"
+
+#include "CaloLattice.h"
+
+class G4Track;
+class B4ReadoutWorld;
+
+/// Readout cells of the parallel world: remembers the cell of the current
+/// step of the current track for the stepping action.
+
+class B4ReadoutSD : public G4VSensitiveDetector
+{
+public:
+  B4ReadoutSD(const G4String &name);
+
+  virtual G4bool ProcessHits(G4Step *step, G4TouchableHistory *);
+
+  const G4Track *track; // of the last step seen
+  G4int stepNumber;
+  G4int ix, iy, iz;
+};
+
+/// Parallel world with the readout segmentation (readoutWorld true): a box
+/// over the calorimeter with the same rotation, replicated into channel
+/// columns (x), channels (y) and z-slices.  The copy numbers of its
+/// touchable are the channel index, independent of the mass geometry.
+///
+///   gridSizeX x gridSizeY rods per channel,
+///   readoutSliceZ per slice; cells start at the first rod/layer and at the
+///   front face.
+
+class B4ReadoutWorld : public G4VUserParallelWorld
+{
+public:
+  B4ReadoutWorld(const G4String &name, const CaloLattice &lattice, G4int rodsPerChannel,
+                 G4int layersPerChannel, G4double sliceZ, G4double rotationX, G4double rotationY);
+  virtual ~B4ReadoutWorld();
+
+  virtual void Construct();
+  virtual void ConstructSD();
+
+  // channel and slice of the current step of track, false: not in the
+  // readout.  Once per step, from the stepping action.
+  G4bool cell(const G4Track *track, G4int &ix, G4int &iy, G4int &iz);
+
+private:
+  CaloLattice fLattice;
+  G4int fRodsPerChannel;
+  G4int fLayersPerChannel;
+  G4double fSliceZ;
+  G4double fRotationX, fRotationY;
+  B4ReadoutSD *fSD;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -33,7 +33,11 @@
 #include "G4UserRunAction.hh"
 #include "globals.hh"
 
+#include <chrono>
+
 class CaloTree;
+class CaloPhysicsCache;
+class B4bSteppingAction;
 class B4bRunAction : public G4UserRunAction
 {
 public:
@@ -43,8 +47,14 @@ public:
   virtual void BeginOfRunAction(const G4Run *);
   virtual void EndOfRunAction(const G4Run *);
 
+  void setPhysicsCache(CaloPhysicsCache *cache) { physicsCache = cache; }
+  void setSteppingAction(B4bSteppingAction *stepping) { steppingAction = stepping; }
+
 private:
   CaloTree *hh;
+  CaloPhysicsCache *physicsCache;
+  B4bSteppingAction *steppingAction;
+  std::chrono::steady_clock::time_point runStart;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
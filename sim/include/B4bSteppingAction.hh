@@ -33,11 +33,13 @@
 #include "G4UserSteppingAction.hh"
 
 #include "B4bEventAction.hh"
+#include "CaloLattice.h"
 // class B4bEventAction;
 
 class CaloID;
 class CaloHit;
 class CaloTree;
+class B4ReadoutWorld;
 
 /// Stepping action class.
 ///
@@ -48,14 +50,35 @@ class CaloTree;
 class B4bSteppingAction : public G4UserSteppingAction
 {
 public:
-  B4bSteppingAction(B4bEventAction *eventAction, CaloTree *histo);
+  B4bSteppingAction(B4bEventAction *eventAction, B4DetectorConstruction *detector, CaloTree *histo);
   virtual ~B4bSteppingAction();
 
   virtual void UserSteppingAction(const G4Step *step);
 
+  // step counts for the step rates printed by B4bRunAction
+  long steps() const { return nSteps; }
+  long opticalSteps() const { return nOpticalSteps; }
+  void resetCounts() { nSteps = nOpticalSteps = 0; }
+
 private:
   B4bEventAction *fEventAction;
   CaloTree *hh;
+  CaloLattice lattice;
+  bool hybrid; // detailWindow: the calorimeter volume is homogenized rods
+  const B4DetectorConstruction::RodMix &rodMix; // hybrid: set at Construct()
+  B4ReadoutWorld *readout; // readoutWorld: channel and slice of the step
+  int opWindow[4]; // optical photons followed: rodMin, rodMax, layerMin, layerMax
+  long nSteps;
+  long nOpticalSteps;
+
+  // layer and rod of the step, returns the fiber copy number (-1: none)
+  int locateCell(const G4Step *step, int &layer, int &rod);
+
+  // energy and hit of the step in a channel
+  void bookDeposit(const G4Step *step, int caloType, int fiberNumber, int layerNumber, int rodNumber, double edep,
+                   double birks, double ncer, double ncercap);
+  void bookHomogenized(const G4Step *step, int layerNumber, int rodNumber, double edep);
+  void homogenizedCerenkov(const G4Step *step, double path, double &ncer, double &ncercap);
 
   double getBirk(const G4Step *step);
   double getBirkHC(double dEStep, double step, double charge, double density);
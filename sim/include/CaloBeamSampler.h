@@ -0,0 +1,77 @@
+#ifndef CaloBeamSampler_h
+#define CaloBeamSampler_h 1
+
+#include <string>
+#include <vector>
+
+// beam of the single-particle gun: spot, direction and energy of one event
+// from a fixed number of flat random numbers, so the generator draws them
+// in one batch (draws()).  Resolved once from the mac file:
+//
+//   spot       flat: x, y uniform in gun_x/y_min..max
+//              gauss: Gaussian around the centre of that range, beamSigmaX/Y
+//   z          uniform in gun_z_min..max
+//   direction  pMomentum_*, turned by the incident angles beamAngleX (in
+//              x-z) and beamAngleY (in y-z), plus a Gaussian divergence
+//   energy     uniform in gun_energy_min..max, or from a tabulated spectrum
+//              (beamSpectrum), smeared by beamEnergySpread
+//
+// beamSettings: a table of test-beam settings (energy range and angles);
+// each event picks one by weight, so one job covers a whole configuration.
+//
+// Random numbers r[0..draws()-1], units cm, GeV, degree:
+//   r[0..2] unused (sequence of earlier versions), r[3], r[4] spot,
+//   r[5] z, r[6] energy, then if used: divergence (2), energy spread (2),
+//   setting (1).
+class CaloBeamSampler
+{
+public:
+  struct Config
+  {
+    double min[4] = {0, 0, 0, 0}; // x, y, z (cm), energy (GeV)
+    double max[4] = {0, 0, 0, 0};
+    double direction[3] = {0, 0, 1};
+    bool gaussSpot = false;
+    double sigmaX = 0, sigmaY = 0;           // cm
+    double angleX = 0, angleY = 0;           // degree
+    double divergenceX = 0, divergenceY = 0; // mrad
+    double energySpread = 0;                 // relative
+    std::string spectrumFile;                // "" or "none": flat
+    std::string settingsFile;                // "" or "none": one setting
+  };
+
+  struct Beam
+  {
+    double x, y, z;    // cm
+    double energy;     // GeV
+    double dx, dy, dz; // unit vector
+    int setting;       // line of beamSettings, 0 without
+  };
+
+  CaloBeamSampler(const Config &config);
+
+  int draws() const { return nDraws; }
+  void sample(const double *r, Beam &beam) const;
+  void print() const;
+
+private:
+  struct Setting
+  {
+    double energyMin, energyWidth; // GeV
+    double angleX, angleY;         // rad
+  };
+
+  void readSpectrum(const std::string &file);
+  void readSettings(const std::string &file);
+
+  Config conf;
+  int nDraws;
+  int divergenceDraw, spreadDraw, settingDraw; // first r[] index, -1: unused
+
+  // spectrum: bins [binLow[i], binLow[i] + binWidth[i]), cumulative probability
+  std::vector<double> binLow, binWidth, binCdf;
+  std::vector<Setting> settings;
+  std::vector<double> settingCdf;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef CaloEventCatalog_h
+#define CaloEventCatalog_h 1
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// event catalog (eventCatalog true, and the caloCatalog tool): maps a
+// global event index to the output file and tree entry of the event, its
+// random engine seeds and its beam.  One fixed-size record per event, so
+// event i is one seek away in catalogs over thousands of files.
+//
+//   CaloCatalogHeader
+//   CaloCatalogRecord[nEvents]
+//   (free space for records of the writer)
+//   file table at fileTableOffset: nFiles '\0'-terminated file names,
+//   relative to the directory of the catalog (or absolute)
+//
+// Native byte order.  A catalog being written is valid up to its last
+// flush(), also when the writer is killed: records are only added in the
+// free space, and the table moves out (new copy first, then the header)
+// before they would reach it.  close() removes the free space.
+namespace CaloCatalog
+{
+  const std::uint32_t kMagic = 0x43455843; // "CXEC"
+  const std::uint16_t kVersion = 1;
+}
+
+struct CaloCatalogHeader
+{
+  std::uint32_t magic;
+  std::uint16_t version;
+  std::uint16_t recordSize; // sizeof(CaloCatalogRecord)
+  std::uint32_t nFiles;
+  std::uint32_t reserved;
+  std::uint64_t nEvents;
+  std::uint64_t fileTableOffset;
+};
+
+struct CaloCatalogRecord
+{
+  std::int64_t entry; // entry of "tree" in the file, -1: not in the ntuple
+  std::int32_t file;  // index in the file table
+  std::int32_t run;
+  std::int32_t event;
+  std::int32_t beamID;   // pdg ID
+  std::int64_t seeds[2]; // random engine seeds at the start of the event
+  float beamE;           // MeV
+  float beamX, beamY, beamZ; // mm
+};
+
+// read access.
+//
+//   CaloEventCatalog cat("mc_..._catalog.cxc");
+//   CaloCatalogRecord rec;
+//   if (cat.get(123456, rec))  // from the directory of the catalog
+//     TFile::Open(cat.file(rec.file).c_str())->Get<TTree>("tree")->GetEntry(rec.entry);
+class CaloEventCatalog
+{
+public:
+  CaloEventCatalog(std::string path);
+  ~CaloEventCatalog();
+
+  bool good() const { return fp != nullptr; }
+  long size() const { return long(header.nEvents); }
+  int nFiles() const { return int(files.size()); }
+  const std::string &file(int i) const { return files[i]; }
+
+  bool get(long index, CaloCatalogRecord &rec) const;
+
+private:
+  std::FILE *fp;
+  CaloCatalogHeader header;
+  std::vector<std::string> files;
+};
+
+// write access, appending one event at a time.
+class CaloCatalogWriter
+{
+public:
+  CaloCatalogWriter(std::string path);
+  // continue a catalog with its first nEvents events and nFiles files.
+  CaloCatalogWriter(std::string path, long nEvents, int nFiles);
+  ~CaloCatalogWriter();
+
+  int addFile(std::string name); // index for CaloCatalogRecord::file
+  void add(const CaloCatalogRecord &rec);
+  void flush(); // header and file table: readable up to here
+  void close();
+
+  long size() const { return nEvents; }
+  int fileCount() const { return int(files.size()); }
+
+private:
+  static const long kMinFree = 4096; // records of free space at least
+
+  long long recordOffset(long i) const
+  {
+    return sizeof(CaloCatalogHeader) + i * (long long)sizeof(CaloCatalogRecord);
+  }
+  void relocate();
+  void writeTable();
+  void writeHeader();
+
+  std::FILE *fp;
+  long nEvents;
+  std::vector<std::string> files;
+  long long tableOffset; // file table of the last flush
+  long long tableBytes;
+};
+
+#endif
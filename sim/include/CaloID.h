@@ -1,16 +1,55 @@
 #ifndef CaloID_h
 #define CaloID_h 1
 
+#include <cstdint>
+
+typedef std::uint64_t CaloKey; // packed channel/slice key (see CaloIDLayout)
+
+// compile-time bit layout of CaloKey.  fields are packed from the least
+// significant bit in the order of the enum below.
+namespace CaloIDLayout
+{
+   enum Field
+   {
+      kType,  //  1=rod, 2=sc,  3=ch
+      kArea,  //  0=Al-block, 1=no-SiPM, 2=6mm, 3=3mm
+      kIx,    //  [0,29], up to 127 for finer readout segmentations
+      kIy,    //  [0,19], up to 127
+      kIxx,   //  [0]
+      kIyy,   //  [0,7]
+      kZtype, //  1=zslice, 2=tslice, 3=2D
+      kIz,    //  z- or t-slice index
+      kNFields
+   };
+
+   constexpr unsigned bits[kNFields] = {2, 2, 7, 7, 3, 3, 2, 24};
+
+   constexpr unsigned shift(int f) { return f == 0 ? 0 : shift(f - 1) + bits[f - 1]; }
+   constexpr CaloKey mask(int f) { return (CaloKey(1) << bits[f]) - 1; }
+   constexpr CaloKey lowMask(int f) { return (CaloKey(1) << shift(f)) - 1; } // all fields below f
+   constexpr int maxValue(int f) { return int(mask(f)); }
+
+   template <int F>
+   constexpr CaloKey pack(int v) { return (CaloKey(v) & mask(F)) << shift(F); }
+   template <int F>
+   constexpr int unpack(CaloKey k) { return int((k >> shift(F)) & mask(F)); }
+
+   constexpr unsigned totalBits = shift(kNFields);
+   static_assert(totalBits <= 64, "CaloKey layout does not fit into 64 bits");
+}
+
 class CaloID
 {
 public:
    CaloID();
    ~CaloID();
    CaloID(int a_type, int a_fiber, int a_layer, int a_rod, double a_z, double a_t);
-   CaloID(int _key);
+   // channel and z-slice given, e.g. by the readout world
+   CaloID(int a_type, int a_fiber, int a_layer, int a_rod, double a_z, double a_t, int a_ix, int a_iy, int a_zslice);
+   CaloID(CaloKey _key);
 
-   int getTkey(); // time-slice (50ps/slice)  based key
-   int getZkey(); // z-slice (cm/slice)) based key
+   CaloKey getTkey(); // time-slice (50ps/slice)  based key
+   CaloKey getZkey(); // z-slice (cm/slice)) based key
 
    int type() { return _type; }
    int area() { return _area; }
@@ -23,11 +62,30 @@ public:
 
    void print();
 
+   static CaloKey packKey(int type, int area, int ix, int iy, int ixx, int iyy, int ztype, int iz);
+
+   // calorimeter and readout segmentation of the run (B4DetectorConstruction,
+   // from the mac file): slices count from the front face, areas follow the
+   // SiPM cells (3 x 4 rods) of the module, not the channel grid.
+   static void setGeometry(int nRods, int nLayers, double length, int rodsPerChannel, int layersPerChannel,
+                           double dz);
+
 private:
+   void init(int a_type, int a_fiber, int a_layer, int a_rod, double a_z, double a_t, int a_ix, int a_iy,
+             int a_zslice);
    int findArea();
 
-   int packKey(int type, int area, int ix, int iy, int ixx, int iyy, int ztype, int iz);
-   int unpackKey(unsigned int k);
+   static int nIx;       // channels in x: rods / nRodsX
+   static int nIy;       // channels in y: layers / nLayersY
+   static int nRodsX;    // rods per channel in x
+   static int nLayersY;  // layers per channel in y
+   static int nSx;       // SiPM cells in x
+   static int nSy;       // SiPM cells in y
+   static double sliceZ; // mm
+   static double zFront; // mm
+   static double zLength; // mm
+
+   int unpackKey(CaloKey k);
 
    float z0;
    float t0;
@@ -37,15 +95,15 @@ private:
    int _rod;   // [1,90] horizontal axis
    int _fiber; // c[1,5], s[1,3]
 
-   // key   (30 bits total)
+   // key   (50 bits total, see CaloIDLayout::bits)
    //   _type (2 bits)   1=rod, 2=sc,  3=ch
    //   _area (2 bits)   0=Al-block, 1=no-SiPM, 2=6mm, 3=3mm
-   //   _ix   (5 bits)   [0,29]
-   //   _iy   (5 bits)   [0,19]
+   //   _ix   (7 bits)   [0,29]
+   //   _iy   (7 bits)   [0,19]
    //   _ixx  (3 bits)   [0]
    //   _iyy  (3 bits)   [0,7]
    //   _ztype  (2 bit)  1=zslice, 2=tslice, 3=2D
-   //   _iz   (8 bits)   [0,255]
+   //   _iz   (24 bits)  [0,16777215]
 
    int _type; // [1,3]   1=rod, 2=sc, 3=cer
    int _area; //
@@ -55,8 +113,8 @@ private:
    int _ix;     // rod/nx    [0,29]
    int _iy;     // layer/ny  [0,19]
    int _ztype;  // 1=zslice, 2=tslice, 3=2D
-   int _zslice; //  [0,255]
-   int _tslice; //  [0,255]
+   int _zslice; //  [0,2^24-1]
+   int _tslice; //  [0,2^24-1]
 
    int _nxx; //  =1: numbe of subchannels in x (3mm SiPM)
    int _nyy; //  =8: number of subchannel in y (3mm SiPM)
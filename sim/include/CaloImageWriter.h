@@ -0,0 +1,43 @@
+#ifndef CaloImageWriter_h
+#define CaloImageWriter_h 1
+
+#include <string>
+#include <vector>
+
+class PhotonImage;
+
+// per-event SiPM hit-map images (PhotonImage) written to an HDF5 file as
+// an extensible, chunked and compressed dataset (imageOutput true).
+// Layout follows test/h5builder.py:
+//   /<group>/hist2d_data  float [event][iy][ix]
+//   /<group>/beamE        double (MeV)
+//   /<group>/beamID       int (pdg ID, particle label)
+class CaloImageWriter
+{
+public:
+  CaloImageWriter(std::string fileName, std::string groupName, int nx, int ny,
+                  int chunkEvents, int deflate);
+  ~CaloImageWriter();
+
+  void endEvent(const PhotonImage &image, double beamE, int beamID); // queue one event
+  void close();
+
+  long eventsWritten() const { return nWritten; }
+
+private:
+  void flush(); // write the queued events
+
+  int nx, ny;
+  size_t chunkEvents;
+
+  std::vector<float> pendingImages;
+  std::vector<double> pendingBeamE;
+  std::vector<int> pendingBeamID;
+  long nWritten;
+
+  long long file; // hid_t, kept out of this header
+  long long group;
+  long long dsetImage, dsetBeamE, dsetBeamID;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef CaloLattice_h
+#define CaloLattice_h 1
+
+#include <cmath>
+
+// the regular rod lattice of the calorimeter, with analytic cell lookup:
+// layer and rod from (x, y) in the calorimeter frame, fiber from the
+// offset to the rod centre.  Does not depend on how the lattice is
+// represented in the geometry (geometryNavigation), and needs no walk of
+// the touchable history.
+//
+//   layer 0..nLayers-1 along y, rod 0..nRods-1 along x, both from -size/2
+//   (the copy numbers of the replicas).  Fibers in a hole: Cherenkov 0 in
+//   the centre; around it at 30, 150, 270 degree Cherenkov 1, 2, 3 and at
+//   330, 90, 210 degree scintillation 1, 2, 3.
+//
+// The dimensions come from the mac file (caloRods, caloLayers, caloRodSize,
+// caloLength, caloHoleDiameter, caloFiberRadius, caloFiberCoreRadius,
+// caloFiberGap); the defaults are the full CaloX module.
+struct CaloLattice
+{
+  int nLayers = 80;
+  int nRods = 90;
+  double rodSize = 4.0;          // mm
+  double length = 2000.0;        // rods and fibers, mm
+  double holeDiameter = 2.5;     // mm
+  double fiberRadius = 0.40;     // cladding, mm
+  double fiberCoreRadius = 0.39; // mm
+  double fiberPitch = 0.81;      // centre to centre, mm: 2 fiberRadius + gap
+
+  double sizeX() const { return nRods * rodSize; }
+  double sizeY() const { return nLayers * rodSize; }
+  double sizeZ() const { return length; }
+  // the world around the calorimeter
+  double worldSizeX() const { return 1.4 * sizeX(); }
+  double worldSizeY() const { return 1.4 * sizeY(); }
+  double worldSizeZ() const { return 1.2 * sizeZ(); }
+
+  double rodX(int rod) const { return (rod + 0.5 - 0.5 * nRods) * rodSize; }
+  double rodY(int layer) const { return (layer + 0.5 - 0.5 * nLayers) * rodSize; }
+
+  // false: (x, y) outside the lattice
+  bool cell(double x, double y, int &layer, int &rod) const
+  {
+    layer = int(std::floor(y / rodSize + 0.5 * nLayers));
+    rod = int(std::floor(x / rodSize + 0.5 * nRods));
+    return layer >= 0 && layer < nLayers && rod >= 0 && rod < nRods;
+  }
+
+  // fiber copy number at (dx, dy) from the rod centre, -1: not in a fiber
+  int fiber(double dx, double dy, bool &cherenkov) const
+  {
+    double r2 = fiberRadius * fiberRadius;
+    cherenkov = true;
+    if (dx * dx + dy * dy < r2)
+      return 0;
+
+    // nearest of the six outer fibers, every 60 degree from 30
+    static const int copy[6] = {1, 2, 2, 3, 3, 1};
+    static const bool isC[6] = {true, false, true, false, true, false};
+    double phi = std::atan2(dy, dx) * (180.0 / M_PI);
+    int k = int(std::lround((phi - 30.0) / 60.0));
+    k = ((k % 6) + 6) % 6;
+    double phiK = (30.0 + 60.0 * k) * (M_PI / 180.0);
+    double ex = dx - fiberPitch * std::cos(phiK);
+    double ey = dy - fiberPitch * std::sin(phiK);
+    if (ex * ex + ey * ey >= r2)
+      return -1;
+    cherenkov = isC[k];
+    return copy[k];
+  }
+};
+
+#endif
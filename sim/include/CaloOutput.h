@@ -0,0 +1,173 @@
+#ifndef CaloOutput_h
+#define CaloOutput_h 1
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "TTree.h"
+
+#ifdef CALOX_RNTUPLE
+#include "RVersion.h"
+#include <ROOT/REntry.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 35, 0)
+namespace CaloRNT = ROOT;
+#else
+namespace CaloRNT = ROOT::Experimental;
+#endif
+#endif
+
+class TFile;
+class CaloOutput;
+
+// I/O thread shared by the CaloOutputs of one file (outputAsync true): it
+// fills and compresses staged event records while the simulation goes on.
+class CaloWriterThread
+{
+public:
+  CaloWriterThread();
+  ~CaloWriterThread();
+
+  int acquire(CaloOutput *out);         // free record slot of out, waits if none
+  void submit(CaloOutput *out, int slot); // queue a staged record
+  void drain();                         // wait until everything queued is written
+  void stop();                          // write everything queued, join
+
+  // backpressure metrics
+  long submitted() const { return nSubmitted; }
+  long blocked() const { return nBlocked; }
+  double blockedSeconds() const { return blockedTime.count(); }
+  double busySeconds() const { return busyTime.count(); }
+  size_t maxQueued() const { return maxDepth; }
+
+private:
+  void run();
+
+  std::mutex mtx;
+  std::condition_variable workReady;
+  std::condition_variable slotFree;
+  std::deque<std::pair<CaloOutput *, int>> queue;
+  bool writing; // a record is being written
+  bool stopping;
+  std::thread thread;
+
+  long nSubmitted;
+  long nBlocked;
+  size_t maxDepth;
+  std::chrono::duration<double> blockedTime;
+  std::chrono::duration<double> busyTime;
+};
+
+// one output table of CaloTree: a TTree, or an RNTuple with the same field
+// names (outputFormat rntuple).  Columns are bound to CaloTree members, as
+// with TTree::Branch, and read at every fill().  With a writer thread the
+// members are staged into one of nSlots records at fill() (vectors are
+// swapped, not copied) and written from the I/O thread.
+class CaloOutput
+{
+public:
+  CaloOutput(TFile *file, std::string name, std::string title, bool useRNTuple, int compression,
+             CaloWriterThread *writer = nullptr, int nSlots = 2);
+  ~CaloOutput();
+
+  template <class T>
+  void book(const char *name, T *obj, int basketBytes = 32000);
+
+  void fill();
+  void close(); // commit the RNTuple (the TTree is written with the file)
+
+  bool isRNTuple() const { return useRNTuple; }
+  double fillSeconds() const { return fillTime.count(); }
+  long fillCount() const { return nFills; }
+  long long fileBytes() const { return bytesOnDisk; } // file size after the last write
+
+private:
+  friend class CaloWriterThread;
+
+  struct ColumnBase
+  {
+    virtual ~ColumnBase() {}
+    virtual void stage(int slot) = 0; // simulation thread: member -> slot
+    virtual void load(int slot) = 0;  // I/O thread: slot -> bound storage
+  };
+
+  template <class T>
+  static void stageValue(T &from, T &to) { to = from; }
+  template <class T, class A>
+  static void stageValue(std::vector<T, A> &from, std::vector<T, A> &to) { from.swap(to); }
+
+  template <class T>
+  struct Column : ColumnBase
+  {
+    Column(T *m, int nSlots) : member(m), slots(nSlots) {}
+    void stage(int slot) override { stageValue(*member, slots[slot]); }
+    void load(int slot) override { std::swap(io, slots[slot]); }
+    T *member;
+    T io;
+    std::vector<T> slots;
+  };
+
+  void openWriter();
+  void write();              // fill the TTree/RNTuple from the bound storage
+  void writeSlot(int slot);  // I/O thread
+
+  TFile *file;
+  std::string name;
+  bool useRNTuple;
+  int compression;
+
+  TTree *tree;
+
+#ifdef CALOX_RNTUPLE
+  std::unique_ptr<CaloRNT::RNTupleModel> model;
+  std::unique_ptr<CaloRNT::RNTupleWriter> writer;
+  std::unique_ptr<CaloRNT::REntry> entry;
+  std::vector<std::function<void(CaloRNT::REntry &)>> bindings;
+#endif
+
+  CaloWriterThread *ioThread;
+  std::vector<std::unique_ptr<ColumnBase>> columns;
+  std::vector<int> freeSlots; // guarded by ioThread
+
+  std::chrono::duration<double> fillTime;
+  long nFills;
+  std::atomic<long long> bytesOnDisk; // set by the writing thread
+};
+
+// ------------------------------------------------------------------
+template <class T>
+void CaloOutput::book(const char *name, T *obj, int basketBytes)
+{
+  T *bound = obj;
+  if (ioThread)
+  {
+    Column<T> *col = new Column<T>(obj, int(freeSlots.size()));
+    columns.emplace_back(col);
+    bound = &col->io;
+  }
+
+  if (!useRNTuple)
+  {
+    tree->Branch(name, bound, basketBytes);
+    return;
+  }
+#ifdef CALOX_RNTUPLE
+  // RNTuple pages are sized by the writer; basketBytes only applies to TTree.
+  model->template MakeField<T>(name);
+  std::string field = name;
+  bindings.push_back([field, bound](CaloRNT::REntry &e)
+                     { e.BindRawPtr(field, bound); });
+#endif
+}
+
+#endif
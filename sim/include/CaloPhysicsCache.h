@@ -0,0 +1,43 @@
+#ifndef CaloPhysicsCache_h
+#define CaloPhysicsCache_h 1
+
+#include <chrono>
+#include <string>
+
+class G4VUserPhysicsList;
+
+// physics tables shared by the jobs of a campaign (physicsTableCache):
+// the first job with a given physics list, Geant4 version, production cuts
+// and materials of the geometry stores its tables in
+//
+//   <cacheDir>/g4<version>_<key>/    tables, and build.txt: seconds to build
+//
+// and later jobs retrieve them instead of building.  The directory appears
+// by rename when complete, so concurrent first jobs are safe.
+//
+//   prepare()     after G4RunManager::Initialize, before /run/beamOn
+//   tablesReady() BeginOfRunAction: tables built or retrieved
+//   store()       after the run
+class CaloPhysicsCache
+{
+public:
+  CaloPhysicsCache(std::string cacheDir, std::string physicsName);
+
+  void prepare(G4VUserPhysicsList *physicsList);
+  void tablesReady();
+  void store(G4VUserPhysicsList *physicsList);
+
+private:
+  std::string signature(G4VUserPhysicsList *physicsList) const;
+
+  std::string dir;
+  std::string physics;
+  std::string tableDir; // <dir>/g4<version>_<key>
+  bool retrieved;
+  bool timed;
+  double buildSeconds; // of the job that stored the tables
+  double tableSeconds; // this job
+  std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CaloPythiaGenerator_h
+#define CaloPythiaGenerator_h 1
+
+#include <string>
+#include <vector>
+
+namespace Pythia8
+{
+  class Pythia;
+}
+
+// Pythia8 events generated in the job (CaloXPythiaON=2), instead of read
+// from py8tree files: set up once from a card file (CaloXPythiaCard), then
+// one event per Geant4 event from a seed the caller derives from the
+// Geant4 engine, so an event is reproduced by its Geant4 seeds alone.
+//
+// Needs a build with WITH_PYTHIA8 (CALOX_PYTHIA8); otherwise the
+// constructor exits.
+class CaloPythiaGenerator
+{
+public:
+  struct Particle
+  {
+    int pid;
+    double px, py, pz; // GeV
+  };
+
+  CaloPythiaGenerator(std::string cardFile);
+  ~CaloPythiaGenerator();
+
+  // final-state particles of the next event from seed 1..kMaxSeed, false:
+  // Pythia failed on every try
+  bool generate(int seed, std::vector<Particle> &particles);
+  void list() const; // the last event, Pythia listing
+
+  static const int kMaxSeed = 900000000;
+
+private:
+  Pythia8::Pythia *pythia;
+  long nEvents;
+  long nFailed; // aborted next() calls
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef CaloShardIndex_h
+#define CaloShardIndex_h 1
+
+#include <map>
+#include <string>
+#include <vector>
+
+// JSON index of the output shards of one job (outputShardEvents,
+// outputShardMB): run configuration and seeds, and per shard its file,
+// event range and the random engine seeds at its first event.  Rewritten
+// whenever a shard is opened or closed, so a job that dies still leaves a
+// valid index of its closed shards.
+//
+//   { "config": {key: value, ...}, "seeds": [s0, s1],
+//     "shards": [ {"file": ..., "firstEvent": ..., "lastEvent": ...,
+//                  "events": ..., "ntupleEvents": ..., "seeds": [s0, s1],
+//                  "bytes": ..., "closed": true}, ... ] }
+class CaloShardIndex
+{
+public:
+  struct Shard
+  {
+    std::string file;
+    long firstEvent = 0; // event numbers as in the tree (1, 2, ...)
+    long lastEvent = 0;
+    long events = 0;       // events simulated while the shard was open
+    long ntupleEvents = 0; // of which in the tree (eventsInNtupe)
+    long seeds[2] = {0, 0};
+    long long bytes = 0;
+    bool closed = false;
+  };
+
+  CaloShardIndex(std::string fileName, const std::map<std::string, std::string> &config);
+
+  void setRunSeeds(long s0, long s1);
+  Shard &open(std::string shardFile); // new current shard
+  Shard &current() { return shards.back(); }
+  void close(long long bytes);        // current shard is complete
+  void restore(const Shard &shard);   // closed shard of a resumed job
+  void write() const;
+
+  int size() const { return int(shards.size()); }
+  const Shard &shard(int i) const { return shards[i]; }
+
+private:
+  std::string path;
+  std::map<std::string, std::string> config;
+  long runSeeds[2];
+  std::vector<Shard> shards;
+};
+
+#endif
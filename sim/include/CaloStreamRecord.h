@@ -0,0 +1,44 @@
+#ifndef CaloStreamRecord_h
+#define CaloStreamRecord_h 1
+
+#include <cstdint>
+
+// binary event record of the stream output (streamOutput true), shared by
+// CaloStreamWriter and the reader library in sim/stream.  Native byte order:
+// the consumer runs on the same node.
+//
+//   CaloStreamHeader
+//   CaloStreamChannel[nSS]     scintillation SiPM hits (id3dSS, ph3dSS)
+//   CaloStreamChannel[nCC]     Cherenkov SiPM hits (id3dCC, ph3dCC)
+//   float[imageNy * imageNx]   photon-exit image [iy][ix], if any
+namespace CaloStream
+{
+  const std::uint32_t kMagic = 0x52535843; // "CXSR"
+  const std::uint16_t kVersion = 1;
+}
+
+struct CaloStreamHeader
+{
+  std::uint32_t magic;
+  std::uint16_t version;
+  std::uint16_t headerSize; // sizeof(CaloStreamHeader)
+  std::uint32_t payloadSize; // bytes after the header
+  std::int32_t run;
+  std::int32_t event;
+  std::int32_t beamID; // pdg ID
+  float beamE;         // MeV
+  float beamX, beamY, beamZ; // mm
+  float sum3dSS, sum3dCC;
+  std::uint32_t nSS;
+  std::uint32_t nCC;
+  std::uint16_t imageNx; // 0: no image
+  std::uint16_t imageNy;
+};
+
+struct CaloStreamChannel
+{
+  std::int32_t id; // xxxyyyttt, as id3dSS/id3dCC
+  float ph;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CaloStreamWriter_h
+#define CaloStreamWriter_h 1
+
+#include <string>
+#include <vector>
+
+#include "CaloStreamRecord.h"
+
+// publishes finished events as CaloStreamRecords on a local Unix-domain
+// socket (streamOutput true).  One consumer at a time; events finished
+// while no consumer is connected are dropped.  A connected consumer sets
+// the pace: writes block when it falls behind.
+class CaloStreamWriter
+{
+public:
+  CaloStreamWriter(std::string socketPath);
+  ~CaloStreamWriter();
+
+  void publish(CaloStreamHeader header,
+               const std::vector<CaloStreamChannel> &ss,
+               const std::vector<CaloStreamChannel> &cc,
+               const std::vector<float> *image, int nx, int ny);
+  void close();
+
+  long published() const { return nPublished; }
+  long dropped() const { return nDropped; }
+
+private:
+  void acceptConsumer(); // non-blocking
+  bool sendAll(const void *buf, size_t n);
+
+  std::string path;
+  int listenFd;
+  int clientFd;
+  long nPublished;
+  long nDropped;
+};
+
+#endif
@@ -8,28 +8,113 @@
 #include <map>
 #include <math.h> // for sin(x) etc.
 #include <memory>
+#include <memory_resource>
 #include <sstream> // for string stream
 #include <string>
 #include <vector>
 
+#include "CaloID.h"     // for CaloKey
+#include "CaloStreamRecord.h"
+#include "EventArena.h" // per-event storage
+
 class TFile;
 class TTree;
 class TH1D;
 class TH2D;
 
 class CaloHit;
+class CaloOutput;
+class CaloShardIndex;
+class CaloCatalogWriter;
+class CaloWriterThread;
+class CaloImageWriter;
+class CaloStreamWriter;
+class PhotonImage;
 struct PhotonInfo;
 
 using namespace std;
 
+// truth hit steps merged into one (fiber, fine z, fine t) cell.
+struct TruthDeposit
+{
+  int pid;     // of the step with the largest edep
+  int trackid; //
+  int calotype;
+  int layerNumber;
+  int rodNumber;
+  int fiberNumber;
+  int nsteps;
+  double edepMax;
+  double edep;
+  double edepNonIon;
+  double edepInv;
+  double edepbirk;
+  double ncer;
+  double ncercap;
+  double wx, wy, wz; // edep-weighted sums
+  double wsteplength;
+  double wglobaltime;
+  double wlocaltime;
+};
+
+// OP_flags word of the compact output schema (outputSchema compact).
+namespace OPFlags
+{
+  enum Bit
+  {
+    kCerenkov = 0,
+    kScintillation = 1,
+    kCoreC = 2,
+    kCoreS = 3,
+    kCladC = 4,
+    kCladS = 5
+  };
+  const int kProductionFiberShift = 8; // 4 bits, fiber number + 1 (0: not in a fiber)
+  const int kFinalFiberShift = 12;     // 4 bits, fiber number + 1
+}
+
+// key of a compact truth deposit (truthHitMode compact), from the lowest bit:
+// calotype(2) layer(8) rod(8) fiber(4) zbin(20) tbin(22).
+namespace TruthKey
+{
+  const int kLayerBits = 8;
+  const int kRodBits = 8;
+}
+
+// per-event containers allocated from CaloTree's EventArena.
+typedef std::pmr::map<CaloKey, double> HitMap;
+typedef std::pmr::map<std::uint64_t, TruthDeposit> TruthMap;
+typedef std::pmr::vector<PhotonInfo> PhotonVector;
+
 class CaloTree
 {
 public:
+  // output tiers (outputTier): each one books and fills the columns of the
+  // ones below it.
+  enum OutputTier
+  {
+    kTierSummary = 0,  // run, beam, energy sums, hit counts
+    kTierChannels = 1, // + SiPM channels (*3dSS, *3dCC)
+    kTierTruth = 2,    // + truthhit_*
+    kTierFull = 3      // + optical photons (OP_*)
+  };
+
   CaloTree(string, int argc, char **argv); // string outname
   ~CaloTree();                             // string outname
   void BeginEvent();
   void EndEvent();
   void EndJob();
+  void setRunSeeds(long s0, long s1); // recorded in the shard index
+
+  //  checkpoint/restart (checkpointEvents, -resume true)
+  void resumeEngine();                    // random engine of the last checkpoint
+  int eventsToRun();                      // numberOfEvents not done yet
+  void setPy8Event(long n) { py8Event = n; } // next Pythia entry
+  long resumePy8Event() const { return resumed ? py8Event : -1; }
+
+  //  per-event seeding (eventSeeding event) and -replayEvent N
+  void seedEvent(); // from PrimaryGeneratorAction, before any random number
+  int replayEventNumber() const { return replayEvent; }
 
   //  inout paramter handling ....
   bool setParam(string key, string val);
@@ -41,6 +126,9 @@ public:
   void accumulateHits(CaloHit aHit);
   void accumulateEnergy(double eleak, int type);
   void saveBeamXYZE(string, int, float, float, float, float);
+  void saveBeamDirection(float dx, float dy, float dz);
+  void checkPhotonBudget(int activeTrackID);
+  bool savePhotons() const { return recordPhotons; }
 
   // for histogrming...
   std::string title;
@@ -49,7 +137,11 @@ public:
   std::map<std::string, TH2D *> histo2D;
   std::map<std::string, TH2D *>::iterator histo2Diter;
 
-  vector<PhotonInfo> photonData;
+private:
+  EventArena eventArena; // must be declared before the containers using it.
+
+public:
+  PhotonVector photonData;
 
 private:
   // private functions.
@@ -60,15 +152,26 @@ private:
 
   //
   void clearCaloTree();
+  bool eventInNtuple(int event); // event number from 1: written to the tree
   void analyze();
-
-  map<int, double> make2Dhits(map<int, double> hits);
+  void fillChannelHits();
+  void publishEvent();
+  void fillPhotonVectors(PhotonVector::const_iterator first, PhotonVector::const_iterator last);
+  void openShard();  // output file and trees
+  void closeShard(); // write, close and index the current one
+  void writeCheckpoint();
+  void readCheckpoint(long &catalogEvents, int &catalogFiles);
+  void bookPhotonBranches(CaloOutput *t);
+  void resetPhotonVectors();
+
+  HitMap make2Dhits(const HitMap &hits);
   void defineCSV(string type);
-  void writeCSV(string type, map<int, double> &hits);
+  void writeCSV(string type, HitMap &hits);
 
   string beamType;
   int beamID;
   float beamX, beamY, beamZ, beamE;
+  float beamDx = 0, beamDy = 0, beamDz = 0; // direction of the gun, 0 for Pythia events
   //
   string runConfig;
   int runNumber;
@@ -77,8 +180,28 @@ private:
   int eventCountsALL;
 
   bool createNtuple;
+  int outputTier; // OutputTier, capped at kTierChannels by miniNtuple
+  bool recordPhotons; // photons are kept: OP_* output (full tier) or images
+
+  PhotonImage *photonImage;       // image of the current event (images or stream, else null)
+  CaloImageWriter *imageWriter;   // HDF5 SiPM images (imageOutput true, else null)
+  CaloStreamWriter *streamWriter; // socket output (streamOutput true, else null)
+  vector<CaloStreamChannel> streamSS;
+  vector<CaloStreamChannel> streamCC;
 
   bool saveTruthHits;
+  bool compactTruthHits;   // merge truth steps into (fiber, z-bin, t-bin) deposits
+  double truthCompactDz;   // cm
+  double truthCompactDt;   // ns
+  TruthMap truthDeposits; // used when compactTruthHits
+  void fillCompactTruth();
+
+  size_t vectorMaxBytes; // ntuple vectors above this capacity are freed at BeginEvent
+
+  size_t photonBudgetBytes; // photonData above this is spilled to spillTree (0=off)
+
+  bool compactSchema; // float truthhit_*/OP_* columns and packed OP_flags
+  int basketBytes;    // basket size of the truthhit_* and OP_* branches
 
   // hit data in csv file
   map<string, int> csvEvents; // number of events to be written to csv file.
@@ -90,29 +213,55 @@ private:
 
   // ntuple file definition...
   TFile *fout;
-  TTree *tree;
+  CaloOutput *tree;      // TTree, or RNTuple with outputFormat rntuple
+  CaloOutput *spillTree; // optical photons flushed during the event, keyed by (event, chunk)
+  CaloWriterThread *ioThread; // fills tree and spillTree when outputAsync (else null)
+  bool useRNTuple;
+  int queueDepth;
+
+  //  output shards (outputShardEvents, outputShardMB)
+  string outBaseName; // rootPre_jobName_run..., without extension
+  long shardMaxEvents;
+  long long shardMaxBytes;
+  CaloShardIndex *shardIndex;
+  double fillSeconds; // of the closed shards
+  long fillCount;
+  CaloCatalogWriter *catalog; // eventCatalog true, else null
+  int catalogFile;            // current shard in the catalog file table
+  long eventSeeds[2];         // seeds of this event, or engine seeds before its primaries
+  bool perEventSeeds;         // eventSeeding event
+  int replayEvent;            // replayEvent N, 0: normal job
+
+  //  checkpoints
+  int checkpointEvents;
+  string checkpointName;   // <outBaseName>_checkpoint(.txt)
+  string checkpointEngine; // engine status file of the last checkpoint
+  bool resumed;
+  long py8Event; // next Pythia entry, -1: no Pythia input
 
   //  accumulated energyr of photons
   //  in rods
-  map<int, double> rtHits; // T-slice  (nominal 50 ps/slicen), edep
-  map<int, double> rzHits; // Z-slice  (nominal 2 cm/slice)  , edep
-  map<int, double> rzEdep; // Z-slice  (nominal 2 cm/slice)  , edep
+  HitMap rtHits; // T-slice  (nominal 50 ps/slicen), edep
+  HitMap rzHits; // Z-slice  (nominal 2 cm/slice)  , edep
+  HitMap rzEdep; // Z-slice  (nominal 2 cm/slice)  , edep
 
   // in scit fibers
-  map<int, double> stHits; // T-slice  (nominal 50 ps/slicen), edep-birk
-  map<int, double> szHits; // Z-slice  (nominal 2 cm/slice)  , edep-birk
-  map<int, double> szEdep; // Z-slice  (nominal 2 cm/slice)  , edep
+  HitMap stHits; // T-slice  (nominal 50 ps/slicen), edep-birk
+  HitMap szHits; // Z-slice  (nominal 2 cm/slice)  , edep-birk
+  HitMap szEdep; // Z-slice  (nominal 2 cm/slice)  , edep
 
   // in sherenkov fibers
-  map<int, double> ctHits; // T-slice  (nominal 50 ps/slicen), n-photons
-  map<int, double> czHits; // Z-slice  (nominal 2 cm/slice)  , n-photons
-  map<int, double> czEdep; // Z-slice  (nominal 2 cm/slice)  , edep
+  HitMap ctHits; // T-slice  (nominal 50 ps/slicen), n-photons
+  HitMap czHits; // Z-slice  (nominal 2 cm/slice)  , n-photons
+  HitMap czEdep; // Z-slice  (nominal 2 cm/slice)  , edep
 
   int mRun;
   int mEvent;
 
   int m_run;
   int m_event;
+  long m_seed0; // seeds of the event (eventSeeding event)
+  long m_seed1;
 
   float m_beamMinE;  // GeV
   float m_beamMaxE;  // GeV
@@ -135,6 +284,9 @@ private:
   float m_beamY;
   float m_beamZ;
   float m_beamE;
+  float m_beamDx; // direction cosines
+  float m_beamDy;
+  float m_beamDz;
   string m_beamType;
 
   // truth hit variables (no sipm or time or position smearing applied)
@@ -157,6 +309,14 @@ private:
   vector<int> m_layerNumber;
   vector<int> m_rodNumber;
   vector<int> m_fiberNumber;
+  vector<int> m_nstepstruth; // number of merged steps (compact truth hits only)
+  // compact schema columns (same branch names as above)
+  vector<float> m_xtruthF;
+  vector<float> m_ytruthF;
+  vector<float> m_ztruthF;
+  vector<float> m_steplengthtruthF;
+  vector<float> m_globaltimetruthF;
+  vector<float> m_localtimetruthF;
 
   double m_eCalotruth;
   double m_eWorldtruth;
@@ -196,6 +356,9 @@ private:
 
   // optical photon hit variables
   int mP_nOPs;
+  int mP_nOPspilled; // photons of this event written to spillTree
+  int mP_nOPchunks;  // number of spillTree entries for this event
+  int mP_chunk;
   vector<int> mP_trackid;
   vector<double> mP_pos_produced_x;
   vector<double> mP_pos_produced_y;
@@ -222,6 +385,25 @@ private:
   vector<double> mP_pol_x;
   vector<double> mP_pol_y;
   vector<double> mP_pol_z;
+  // compact schema columns (same branch names as above)
+  vector<unsigned int> mP_flags; // see OPFlags
+  vector<float> mF_pos_produced_x;
+  vector<float> mF_pos_produced_y;
+  vector<float> mF_pos_produced_z;
+  vector<float> mF_mom_produced_x;
+  vector<float> mF_mom_produced_y;
+  vector<float> mF_mom_produced_z;
+  vector<float> mF_time_produced;
+  vector<float> mF_pos_final_x;
+  vector<float> mF_pos_final_y;
+  vector<float> mF_pos_final_z;
+  vector<float> mF_mom_final_x;
+  vector<float> mF_mom_final_y;
+  vector<float> mF_mom_final_z;
+  vector<float> mF_time_final;
+  vector<float> mF_pol_x;
+  vector<float> mF_pol_y;
+  vector<float> mF_pol_z;
 };
 
 #endif
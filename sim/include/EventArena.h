@@ -0,0 +1,54 @@
+#ifndef EventArena_h
+#define EventArena_h 1
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+//  bump allocator for per-event containers (hit maps, optical photons).
+//
+//  memory is handed out from a block of retainedSize bytes that is kept
+//  for the whole job.  requests beyond it go to overflow chunks that are
+//  returned to the heap by reset(), so one huge event does not pin its
+//  memory for the rest of the run.  deallocate() is a no-op: containers
+//  using the arena must be emptied before reset() is called.
+class EventArena : public std::pmr::memory_resource
+{
+public:
+   EventArena();
+   ~EventArena();
+
+   void setRetainedSize(std::size_t bytes); // size of the block kept between events
+   void reset();                            // called at the begin of each event
+
+   std::size_t bytesUsed() const { return usedBytes; }
+   std::size_t peakBytes() const { return peakUsedBytes; }
+   int overflowEvents() const { return nOverflowEvents; }
+
+private:
+   void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+   void do_deallocate(void *, std::size_t, std::size_t) override {}
+   bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+   {
+      return this == &other;
+   }
+
+   struct Chunk
+   {
+      char *data;
+      std::size_t size;
+      std::size_t offset;
+   };
+
+   void *allocateFrom(Chunk &c, std::size_t bytes, std::size_t alignment);
+   void addChunk(std::size_t minBytes);
+
+   Chunk retained;              // kept between events
+   std::vector<Chunk> overflow; // freed in reset()
+
+   std::size_t usedBytes;
+   std::size_t peakUsedBytes;
+   int nOverflowEvents;
+};
+
+#endif
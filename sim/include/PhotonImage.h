@@ -0,0 +1,55 @@
+#ifndef PhotonImage_h
+#define PhotonImage_h 1
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "PhotonInfo.h"
+
+// SiPM hit-map image of one event: exiting optical photons binned in the
+// exit x/y plane (cm), [iy][ix].  Shared by the HDF5 image writer and the
+// stream output.
+class PhotonImage
+{
+public:
+  PhotonImage(int nx_, double xmin_, double dx_, int ny_, double ymin_, double dy_,
+              double zmin_, std::string select)
+      : nx(nx_), ny(ny_), xmin(xmin_), dx(dx_), ymin(ymin_), dy(dy_), zmin(zmin_),
+        selectMask(0), pixels(nx_ * ny_, 0.0f)
+  {
+    if (select.find('C') != std::string::npos)
+      selectMask |= 1; // Cherenkov fiber core
+    if (select.find('S') != std::string::npos)
+      selectMask |= 2; // scintillation fiber core
+  }
+
+  void add(const PhotonInfo &photon)
+  {
+    if (photon.exitPosition.z() <= zmin)
+      return;
+    if (!((photon.isCoreC && (selectMask & 1)) || (photon.isCoreS && (selectMask & 2))))
+      return;
+    int ix = int(std::floor((photon.exitPosition.x() - xmin) / dx));
+    int iy = int(std::floor((photon.exitPosition.y() - ymin) / dy));
+    if (ix < 0 || ix >= nx || iy < 0 || iy >= ny)
+      return;
+    pixels[iy * nx + ix] += 1.0f;
+  }
+
+  void clear() { std::fill(pixels.begin(), pixels.end(), 0.0f); }
+
+  int sizeX() const { return nx; }
+  int sizeY() const { return ny; }
+  const std::vector<float> &data() const { return pixels; }
+
+private:
+  int nx, ny;
+  double xmin, dx, ymin, dy;
+  double zmin; // cm, exit z cut
+  int selectMask;
+  std::vector<float> pixels;
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef PhotonInfo_h
+#define PhotonInfo_h 1
+
 #include "globals.hh"
 #include "G4ThreeVector.hh"
 
@@ -20,3 +23,5 @@ struct PhotonInfo
     G4bool isCladC = false;
     G4bool isCladS = false;
 };
+
+#endif
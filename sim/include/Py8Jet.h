@@ -12,6 +12,8 @@
 #include <TChain.h>
 #include <TFile.h>
 
+#include <string>
+
 // Header file for the classes stored in the TTree if any.
 #include "vector"
 #include "vector"
@@ -71,6 +73,12 @@ public:
    virtual void Loop();
    virtual Bool_t Notify();
    virtual void Show(Long64_t entry = -1);
+
+   // reading for the generator (B4PrimaryGeneratorAction)
+   static Int_t AddFiles(TChain *chain, const std::string &files);
+   void SelectBranches(); // GetEntry reads run, event, nparticles, pid, daughter1, px, py, pz
+   void SetCache(Long64_t bytes, Long64_t firstEntry);
+   void ReadAll(); // the other branches of the current entry (printing)
 };
 
 #endif
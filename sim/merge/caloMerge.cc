@@ -0,0 +1,299 @@
+// merge the ROOT outputs of a campaign (or the shards of one job) into one
+// file: the trees are fast-cloned (baskets copied without decompression),
+// the histograms are summed on a pool of threads, and a mergeIndex tree
+// records where the entries of every input went.
+//
+//   ./caloMerge [-j threads] merged.root input1.root input2.root ...
+//
+// All inputs must have the same trees with the same branches (same
+// outputTier, outputSchema and saveTruthHits), and the same geometry and
+// calibration (gridSize*, calib*).  RNTuple outputs are not handled.
+// merged.root only appears when the merge is complete: it is written as
+// merged.root.part and renamed at the end, or removed on failure.
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TFile.h"
+#include "TH1.h"
+#include "TKey.h"
+#include "TLeaf.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+using namespace std;
+
+namespace
+{
+  // run configuration columns that must agree between the inputs.
+  const char *kConfigColumns[] = {"gridSizeX", "gridSizeY", "gridSizeT",
+                                  "calibSen", "calibSph", "calibCen", "calibCph"};
+
+  // names of the trees and histograms in the top directory of a file.
+  void listObjects(TFile *f, vector<string> &trees, vector<string> &histos)
+  {
+    TIter next(f->GetListOfKeys());
+    while (TKey *key = (TKey *)next())
+    {
+      if (key->GetCycle() != f->GetKey(key->GetName())->GetCycle())
+        continue; // older cycle
+      TClass *cl = TClass::GetClass(key->GetClassName());
+      if (!cl)
+        continue;
+      if (cl->InheritsFrom(TTree::Class()))
+        trees.push_back(key->GetName());
+      else if (cl->InheritsFrom(TH1::Class()))
+        histos.push_back(key->GetName());
+    }
+  }
+
+  // "name:type" of every branch, as the fast clone needs them identical.
+  string schema(TTree *t)
+  {
+    string s;
+    TIter next(t->GetListOfBranches());
+    while (TBranch *b = (TBranch *)next())
+    {
+      s += b->GetName();
+      s += ":";
+      if (b->GetClassName()[0])
+        s += b->GetClassName();
+      else if (TLeaf *leaf = (TLeaf *)b->GetListOfLeaves()->At(0))
+        s += leaf->GetTypeName();
+      s += " ";
+    }
+    return s;
+  }
+
+  // configuration columns of the first entry, empty for an empty tree.
+  vector<float> config(TTree *t)
+  {
+    vector<float> val(sizeof(kConfigColumns) / sizeof(kConfigColumns[0]), 0.0f);
+    if (t->GetEntries() == 0)
+      return vector<float>();
+    t->SetBranchStatus("*", 0);
+    for (size_t i = 0; i < val.size(); i++)
+    {
+      t->SetBranchStatus(kConfigColumns[i], 1);
+      t->SetBranchAddress(kConfigColumns[i], &val[i]);
+    }
+    t->GetEntry(0);
+    t->ResetBranchAddresses();
+    t->SetBranchStatus("*", 1);
+    return val;
+  }
+
+  // sum of the histograms of inputs[first], inputs[first + step], ...
+  void sumHistograms(const vector<string> &inputs, size_t first, size_t step,
+                     map<string, TH1 *> &sum, atomic<bool> &failed)
+  {
+    for (size_t i = first; i < inputs.size(); i += step)
+    {
+      TFile *f = TFile::Open(inputs[i].c_str());
+      if (!f || f->IsZombie())
+      {
+        failed = true;
+        return;
+      }
+      vector<string> trees, histos;
+      listObjects(f, trees, histos);
+      for (auto &name : histos)
+      {
+        TH1 *h = (TH1 *)f->Get(name.c_str());
+        auto it = sum.find(name);
+        if (it == sum.end())
+        {
+          h->SetDirectory(nullptr);
+          sum[name] = h;
+        }
+        else
+        {
+          it->second->Add(h);
+          delete h;
+        }
+      }
+      f->Close();
+      delete f;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int nThreads = 4;
+  vector<string> args;
+  for (int i = 1; i < argc; i++)
+  {
+    if (string(argv[i]) == "-j" && i + 1 < argc)
+      nThreads = max(1, atoi(argv[++i]));
+    else
+      args.push_back(argv[i]);
+  }
+  if (args.size() < 2)
+  {
+    cout << "usage: " << argv[0] << " [-j threads] merged.root input1.root input2.root ..." << endl;
+    return 1;
+  }
+  string outName = args[0];
+  vector<string> inputs(args.begin() + 1, args.end());
+
+  ROOT::EnableThreadSafety();
+  TH1::AddDirectory(false);
+
+  // reference schema and configuration from the first input.
+  TFile *first = TFile::Open(inputs[0].c_str());
+  if (!first || first->IsZombie())
+  {
+    cout << "caloMerge: can not open " << inputs[0] << ". Exit.." << endl;
+    return 1;
+  }
+  vector<string> treeNames, histoNames;
+  listObjects(first, treeNames, histoNames);
+  if (treeNames.empty())
+  {
+    cout << "caloMerge: no TTree in " << inputs[0] << " (RNTuple outputs are not handled). Exit.." << endl;
+    return 1;
+  }
+  map<string, string> refSchema;
+  for (auto &name : treeNames)
+    refSchema[name] = schema(first->Get<TTree>(name.c_str()));
+  vector<float> refConfig = config(first->Get<TTree>("tree"));
+  int compression = first->GetCompressionSettings();
+
+  // histograms: summed on the pool while the trees are copied below.
+  nThreads = min(nThreads, int(inputs.size()));
+  vector<map<string, TH1 *>> partial(nThreads);
+  atomic<bool> histoFailed(false);
+  vector<thread> pool;
+  for (int t = 0; t < nThreads; t++)
+    pool.emplace_back(sumHistograms, cref(inputs), size_t(t), size_t(nThreads), ref(partial[t]),
+                      ref(histoFailed));
+
+  string partName = outName + ".part";
+  TFile *out = new TFile(partName.c_str(), "recreate");
+  out->SetCompressionSettings(compression);
+  map<string, TTree *> outTrees;
+
+  // index of the merged entries: input file -> entry range of "tree".
+  string idxFile;
+  Long64_t idxFirstEntry, idxEntries;
+  int idxRun, idxFirstEvent, idxLastEvent;
+  TTree *index = new TTree("mergeIndex", "caloMerge: entries of tree per input file");
+  index->Branch("file", &idxFile);
+  index->Branch("firstEntry", &idxFirstEntry);
+  index->Branch("entries", &idxEntries);
+  index->Branch("run", &idxRun);
+  index->Branch("firstEvent", &idxFirstEvent);
+  index->Branch("lastEvent", &idxLastEvent);
+
+  bool ok = true;
+  Long64_t nMerged = 0;
+  for (size_t i = 0; i < inputs.size() && ok; i++)
+  {
+    TFile *f = (i == 0) ? first : TFile::Open(inputs[i].c_str());
+    if (!f || f->IsZombie())
+    {
+      cout << "caloMerge: can not open " << inputs[i] << endl;
+      ok = false;
+      break;
+    }
+    for (auto &name : treeNames)
+    {
+      TTree *in = f->Get<TTree>(name.c_str());
+      if (!in || schema(in) != refSchema[name])
+      {
+        cout << "caloMerge: " << inputs[i] << ": " << name
+             << " missing or with other branches than in " << inputs[0] << endl;
+        ok = false;
+        break;
+      }
+      if (name == "tree")
+      {
+        vector<float> conf = config(in);
+        if (!refConfig.empty() && !conf.empty() && conf != refConfig)
+        {
+          cout << "caloMerge: " << inputs[i] << ": run configuration (gridSize*, calib*) differs from "
+               << inputs[0] << endl;
+          ok = false;
+          break;
+        }
+        if (refConfig.empty())
+          refConfig = conf;
+
+        idxFile = inputs[i];
+        idxFirstEntry = nMerged;
+        idxEntries = in->GetEntries();
+        idxRun = idxEntries ? int(in->GetMinimum("run")) : 0;
+        idxFirstEvent = idxEntries ? int(in->GetMinimum("event")) : 0;
+        idxLastEvent = idxEntries ? int(in->GetMaximum("event")) : 0;
+        nMerged += idxEntries;
+        index->Fill();
+      }
+
+      out->cd();
+      if (!outTrees[name])
+      {
+        outTrees[name] = in->CloneTree(0);
+        outTrees[name]->ResetBranchAddresses();
+      }
+      // baskets are copied as they are: no decompression, no re-compression.
+      if (outTrees[name]->CopyEntries(in, -1, "fast") < 0)
+      {
+        cout << "caloMerge: fast copy of " << name << " from " << inputs[i] << " failed" << endl;
+        ok = false;
+        break;
+      }
+    }
+    f->Close();
+    delete f;
+  }
+
+  for (auto &t : pool)
+    t.join();
+  if (!ok || histoFailed)
+  {
+    cout << "caloMerge: merge failed, " << outName << " not written. Exit.." << endl;
+    out->Close();
+    std::remove(partName.c_str());
+    return 1;
+  }
+
+  // partial sums of the threads, in a fixed order.
+  map<string, TH1 *> sum;
+  for (auto &part : partial)
+  {
+    for (auto &h : part)
+    {
+      if (sum.count(h.first))
+      {
+        sum[h.first]->Add(h.second);
+        delete h.second;
+      }
+      else
+      {
+        sum[h.first] = h.second;
+      }
+    }
+  }
+
+  out->cd();
+  for (auto &h : sum)
+    h.second->Write();
+  out->Write();
+  out->Close();
+  if (out->TestBit(TFile::kWriteError) || std::rename(partName.c_str(), outName.c_str()) != 0)
+  {
+    cout << "caloMerge: can not write " << outName << ". Exit.." << endl;
+    std::remove(partName.c_str());
+    return 1;
+  }
+  cout << "caloMerge: " << outName << ": " << inputs.size() << " files, " << nMerged << " events, "
+       << treeNames.size() << " trees, " << sum.size() << " histograms" << endl;
+  return 0;
+}
@@ -39,6 +39,8 @@
 #include "G4LogicalVolume.hh"
 #include "G4PVPlacement.hh"
 #include "G4PVReplica.hh"
+#include "G4PVParameterised.hh"
+#include "G4VPVParameterisation.hh"
 #include "G4GlobalMagFieldMessenger.hh"
 #include "G4AutoDelete.hh"
 
@@ -52,9 +54,62 @@
 
 #include "G4PhysicalConstants.hh"
 #include "G4SystemOfUnits.hh"
-
+#include "G4Version.hh"
+
+#ifdef CALOX_GDML
+#include "G4GDMLParser.hh"
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "B4ReadoutWorld.hh"
+#include "CaloID.h"
 #include "CaloTree.h"
 
+namespace
+{
+    // bump whenever DefineMaterials or DefineVolumes change what they
+    // build: cached snapshots of older geometries are then not used.
+    const int kGeometryVersion = 1;
+
+    // FNV-1a: stable across compilers and runs, unlike std::hash.
+    std::uint64_t fnv1a(const std::string &s)
+    {
+        std::uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // the rods of all layers as one parameterised volume
+    // (geometryNavigation parameterised): copy number layer * nRods + rod.
+    class RodLatticeParameterisation : public G4VPVParameterisation
+    {
+    public:
+        RodLatticeParameterisation(const CaloLattice &l) : lattice(l) {}
+
+        void ComputeTransformation(const G4int copyNo, G4VPhysicalVolume *pv) const override
+        {
+            int layer = copyNo / lattice.nRods;
+            int rod = copyNo % lattice.nRods;
+            pv->SetTranslation(G4ThreeVector(lattice.rodX(rod) * mm, lattice.rodY(layer) * mm, 0.));
+            pv->SetRotation(nullptr);
+        }
+
+    private:
+        CaloLattice lattice;
+    };
+}
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 G4ThreadLocal G4GlobalMagFieldMessenger *B4DetectorConstruction::fMagFieldMessenger = nullptr;
@@ -66,6 +121,82 @@ B4DetectorConstruction::B4DetectorConstruction(CaloTree *histo)
       hh(histo),
       fCheckOverlaps(true)
 {
+    // dimensions from the mac file (cm there, mm in the lattice), parsed
+    // in double precision: getParamF would shift the fibers by nanometers.
+    auto cmParam = [this](const char *key) { return std::atof(hh->getParamS(key).c_str()) * 10.; };
+    fLattice.nRods = hh->getParamI("caloRods");
+    fLattice.nLayers = hh->getParamI("caloLayers");
+    fLattice.rodSize = cmParam("caloRodSize");
+    fLattice.length = cmParam("caloLength");
+    fLattice.holeDiameter = cmParam("caloHoleDiameter");
+    fLattice.fiberRadius = cmParam("caloFiberRadius");
+    fLattice.fiberCoreRadius = cmParam("caloFiberCoreRadius");
+    fLattice.fiberPitch = 2. * fLattice.fiberRadius + cmParam("caloFiberGap");
+    if (fLattice.nRods < 1 || fLattice.nLayers < 1 || fLattice.fiberCoreRadius >= fLattice.fiberRadius ||
+        fLattice.fiberPitch + fLattice.fiberRadius > fLattice.holeDiameter / 2. ||
+        fLattice.holeDiameter >= fLattice.rodSize)
+    {
+        std::cout << "B4DetectorConstruction: fibers do not fit into the holes, or holes into the rods"
+                  << " (caloRods, caloLayers, caloRodSize, caloHoleDiameter, caloFiber*). Exit.." << std::endl;
+        std::exit(0);
+    }
+    // readout segmentation: CaloID from rod/layer numbers, or the cells of
+    // a parallel world (readoutWorld true)
+    G4int rodsPerChannel = hh->getParamI("gridSizeX");
+    G4int layersPerChannel = hh->getParamI("gridSizeY");
+    G4double sliceZ = cmParam("readoutSliceZ");
+    if (rodsPerChannel < 1 || layersPerChannel < 1 || sliceZ <= 0.)
+    {
+        std::cout << "B4DetectorConstruction: bad readout segmentation (gridSizeX, gridSizeY,"
+                  << " readoutSliceZ). Exit.." << std::endl;
+        std::exit(0);
+    }
+    CaloID::setGeometry(fLattice.nRods, fLattice.nLayers, fLattice.length, rodsPerChannel, layersPerChannel, sliceZ);
+    fReadout = nullptr;
+    if (hh->getParamS("readoutWorld").compare(0, 4, "true") == 0)
+    {
+        fReadout = new B4ReadoutWorld("ReadoutWorld", fLattice, rodsPerChannel, layersPerChannel, sliceZ,
+                                      hh->getParamF("caloRotationX"), hh->getParamF("caloRotationY"));
+        RegisterParallelWorld(fReadout);
+    }
+
+    fCacheDir = hh->getParamS("geometryCacheDir");
+    if (fCacheDir == "none")
+        fCacheDir = "";
+    fValidate = hh->getParamS("geometryCheck").compare(0, 4, "true") == 0;
+    if (fValidate)
+        fCheckOverlaps = false; // CheckAllOverlaps() after the build, finer
+
+    fNavigation = hh->getParamS("geometryNavigation");
+    if (fNavigation != "replica" && fNavigation != "parameterised")
+    {
+        std::cout << "B4DetectorConstruction: unknown geometryNavigation " << fNavigation
+                  << " (replica, parameterised). Exit.." << std::endl;
+        std::exit(0);
+    }
+
+    // detailWindow rodMin:rodMax,layerMin:layerMax (inclusive): only these
+    // rods have holes and fibers, the rest of the calorimeter is homogenized.
+    G4String window = hh->getParamS("detailWindow");
+    fHybrid = window != "none";
+    if (fHybrid)
+    {
+        if (std::sscanf(window.c_str(), "%d:%d,%d:%d", &fWindow[0], &fWindow[1], &fWindow[2], &fWindow[3]) != 4 ||
+            fWindow[0] < 0 || fWindow[1] >= fLattice.nRods || fWindow[0] > fWindow[1] ||
+            fWindow[2] < 0 || fWindow[3] >= fLattice.nLayers || fWindow[2] > fWindow[3])
+        {
+            std::cout << "B4DetectorConstruction: bad detailWindow " << window
+                      << " (none, or rodMin:rodMax,layerMin:layerMax). Exit.." << std::endl;
+            std::exit(0);
+        }
+        // the detailed rods are single placements
+        if (fNavigation == "parameterised")
+        {
+            std::cout << "B4DetectorConstruction: detailWindow " << window
+                      << " can not be used with geometryNavigation parameterised. Exit.." << std::endl;
+            std::exit(0);
+        }
+    }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -78,11 +209,173 @@ B4DetectorConstruction::~B4DetectorConstruction()
 
 G4VPhysicalVolume *B4DetectorConstruction::Construct()
 {
+    // snapshot of the same geometry from an earlier job: no materials to
+    // define, no volumes to build, no overlaps to check.
+    G4String cacheFile = GeometryCacheFile();
+    if (!cacheFile.empty() && !fValidate)
+    {
+        G4VPhysicalVolume *world = ReadGeometryCache(cacheFile);
+        if (world)
+        {
+            SetVisAttributes();
+            if (fHybrid)
+                SetRodMix();
+            return world;
+        }
+    }
+
     // Define materials
     DefineMaterials();
 
     // Define volumes
-    return DefineVolumes();
+    G4VPhysicalVolume *world = DefineVolumes();
+    SetVisAttributes();
+    if (fHybrid)
+        SetRodMix();
+
+    if (fValidate)
+        CheckAllOverlaps();
+    if (!cacheFile.empty())
+        WriteGeometryCache(cacheFile, world);
+    return world;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B4DetectorConstruction::GeometrySignature()
+{
+    // everything DefineMaterials/DefineVolumes depend on.
+    std::ostringstream sig;
+    sig << "geometry " << kGeometryVersion << " geant4 " << G4VERSION_NUMBER
+        << " caloRotationX " << hh->getParamF("caloRotationX")
+        << " caloRotationY " << hh->getParamF("caloRotationY")
+        << " navigation " << fNavigation << " detailWindow " << hh->getParamS("detailWindow")
+        << " lattice " << fLattice.nRods << " " << fLattice.nLayers << " " << fLattice.rodSize << " "
+        << fLattice.length << " " << fLattice.holeDiameter << " " << fLattice.fiberRadius << " "
+        << fLattice.fiberCoreRadius << " " << fLattice.fiberPitch;
+    return sig.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B4DetectorConstruction::GeometryCacheFile()
+{
+    if (fCacheDir.empty())
+        return "";
+#ifdef CALOX_GDML
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)fnv1a(GeometrySignature()));
+    return fCacheDir + "/calox_geometry_" + key + ".gdml";
+#else
+    std::cout << "B4DetectorConstruction: geometryCacheDir set, but this build has no GDML support."
+              << " Geometry is built." << std::endl;
+    return "";
+#endif
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VPhysicalVolume *B4DetectorConstruction::ReadGeometryCache(const G4String &fileName)
+{
+#ifdef CALOX_GDML
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0)
+        return nullptr;
+    std::cout << "B4DetectorConstruction: geometry from cache " << fileName << std::endl;
+    G4GDMLParser parser;
+    parser.Read(fileName, false); // written by this program: no schema validation
+    return parser.GetWorldVolume();
+#else
+    (void)fileName;
+    return nullptr;
+#endif
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4DetectorConstruction::WriteGeometryCache(const G4String &fileName, G4VPhysicalVolume *world)
+{
+#ifdef CALOX_GDML
+    struct stat info;
+    if (stat(fileName.c_str(), &info) == 0)
+        return; // --geometryCheck true run, or another job was faster
+    mkdir(fCacheDir.c_str(), 0775);
+
+    // jobs starting together each write their own file; the rename makes
+    // one of them the snapshot, never a half-written file.
+    G4String tmp = fileName + "." + std::to_string(getpid()) + ".tmp";
+    G4GDMLParser parser;
+    parser.Write(tmp, world, true);
+    if (std::rename(tmp.c_str(), fileName.c_str()) == 0)
+        std::cout << "B4DetectorConstruction: geometry cached in " << fileName << std::endl;
+    else
+        std::remove(tmp.c_str());
+#else
+    (void)fileName;
+    (void)world;
+#endif
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4DetectorConstruction::CheckAllOverlaps()
+{
+    // geometryCheck true: every placement against its mother and sisters,
+    // with 10x the surface points of the checks at placement.  A
+    // parameterised volume checks each of its copies; replicas can not
+    // overlap and have no check.
+    std::cout << "B4DetectorConstruction: checking overlaps of all placements..." << std::endl;
+    int nOverlaps = 0;
+    for (auto pv : *G4PhysicalVolumeStore::GetInstance())
+    {
+        if ((!pv->IsReplicated() || pv->IsParameterised()) && pv->CheckOverlaps(10000, 0., true))
+            nOverlaps++;
+    }
+    std::cout << "B4DetectorConstruction: " << nOverlaps << " overlapping placement(s)" << std::endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::vector<B4DetectorConstruction::RodPart> B4DetectorConstruction::RodParts() const
+{
+    // materials from the logical volumes of the detailed rods, so also for
+    // a geometry read from the GDML cache
+    auto material = [](const char *name)
+    { return G4LogicalVolumeStore::GetInstance()->GetVolume(name)->GetMaterial(); };
+    G4double rodArea = fLattice.rodSize * mm * fLattice.rodSize * mm;
+    G4double holeArea = M_PI * fLattice.holeDiameter * mm * fLattice.holeDiameter * mm / 4.;
+    G4double coreArea = M_PI * fLattice.fiberCoreRadius * mm * fLattice.fiberCoreRadius * mm;
+    G4double fiberArea = M_PI * fLattice.fiberRadius * mm * fLattice.fiberRadius * mm;
+    G4double cladArea = fiberArea - coreArea;
+    return {{material("Rod"), rodArea - holeArea, 1},
+            {material("Hole"), holeArea - 7. * fiberArea, 0},
+            {material("fiberCoreC"), 4. * coreArea, 3},
+            {material("fiberCladC"), 4. * cladArea, 0},
+            {material("fiberCoreS"), 3. * coreArea, 2},
+            {material("fiberCladS"), 3. * cladArea, 0}};
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4DetectorConstruction::SetRodMix()
+{
+    std::vector<RodPart> parts = RodParts();
+    G4double mass = 0., area = 0.;
+    for (auto &part : parts)
+    {
+        mass += part.material->GetDensity() * part.area;
+        area += part.area;
+    }
+    fRodMix = RodMix();
+    for (auto &part : parts)
+    {
+        fRodMix.massShare[part.caloType] += part.material->GetDensity() * part.area / mass;
+        fRodMix.areaShare[part.caloType] += part.area / area;
+        if (part.caloType == 2)
+            fRodMix.coreS = part.material;
+        if (part.caloType == 3)
+            fRodMix.coreC = part.material;
+    }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -161,20 +454,20 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
     //   chts[100]
     //
     // Geometry parameters
-    double fiberLength = 200.0 * cm;
-    double holeDiameter = 0.25 * cm;
-    double rodSize = 0.4 * cm;
-    double noLayers = 80.0;
+    double fiberLength = fLattice.length * mm;
+    double holeDiameter = fLattice.holeDiameter * mm;
+    double rodSize = fLattice.rodSize * mm;
+    double noLayers = fLattice.nLayers;
     double layerThickness = rodSize;
-    double noRods = 90.0;
+    double noRods = fLattice.nRods;
 
     double calorSizeX = rodSize * noRods;
     double calorSizeY = rodSize * noLayers;
     double calorSizeZ = fiberLength;
 
-    double worldSizeX = 1.4 * calorSizeX;
-    double worldSizeY = 1.4 * calorSizeY;
-    double worldSizeZ = 1.2 * calorSizeZ;
+    double worldSizeX = fLattice.worldSizeX() * mm;
+    double worldSizeY = fLattice.worldSizeY() * mm;
+    double worldSizeZ = fLattice.worldSizeZ() * mm;
 
     double density;
     int ncomponentsbrass;
@@ -257,37 +550,79 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
     auto layerS = new G4Box("Layer",                                                  // its name
                             calorSizeX / 2.0, layerThickness / 2.0, calorSizeZ / 2.); // its size
 
-    auto layerLV = new G4LogicalVolume(
-        layerS,        // its solid
-        calorMaterial, // its material
-        "Layer");      // its name
-
-    new G4PVReplica(
-        "Layer",         // its name
-        layerLV,         // its logical volume
-        calorLV,         // its mother
-        kYAxis,          // axis of replication
-        noLayers,        // number of replic
-        layerThickness); // width of replica
-
     //
     // Rods in a layer
     //
     auto rodS = new G4Box("Rod",                                          // its name
                           rodSize / 2.0, rodSize / 2.0, calorSizeZ / 2.); // its size
 
-    auto rodLV = new G4LogicalVolume(
-        layerS,        // its solid
-        calorMaterial, // its material
-        "Rod");        // its name
-
-    new G4PVReplica(
-        "Rod",    // its name
-        rodLV,    // its logical volume
-        layerLV,  // its mother
-        kXAxis,   // axis of replication
-        noRods,   // number of replic
-        rodSize); // witdth of replica
+    G4LogicalVolume *rodLV = nullptr;
+    if (fHybrid)
+    {
+        // detailed rods placed in the homogenized calorimeter
+        rodLV = new G4LogicalVolume(
+            rodS,          // its solid
+            calorMaterial, // its material
+            "Rod");        // its name
+
+        for (int layer = fWindow[2]; layer <= fWindow[3]; layer++)
+            for (int rod = fWindow[0]; rod <= fWindow[1]; rod++)
+                new G4PVPlacement(
+                    0,                                                        // no rotation
+                    G4ThreeVector(fLattice.rodX(rod) * mm,                    // lattice position
+                                  fLattice.rodY(layer) * mm, 0.),
+                    rodLV,                                                    // its logical volume
+                    "Rod",                                                    // its name
+                    calorLV,                                                  // its mother  volume
+                    false,                                                    // no boolean operation
+                    layer * fLattice.nRods + rod,                             // copy number
+                    fCheckOverlaps);                                          // checking overlaps
+    }
+    else if (fNavigation == "parameterised")
+    {
+        // one level for the whole lattice: no Layer volume
+        rodLV = new G4LogicalVolume(
+            rodS,          // its solid
+            calorMaterial, // its material
+            "Rod");        // its name
+
+        new G4PVParameterised(
+            "Rod",                                     // its name
+            rodLV,                                     // its logical volume
+            calorLV,                                   // its mother
+            kUndefined,                                // smart voxels in x and y
+            fLattice.nLayers * fLattice.nRods,         // number of rods
+            new RodLatticeParameterisation(fLattice),  // rod positions
+            fCheckOverlaps);                           // checking overlaps
+    }
+    else
+    {
+        auto layerLV = new G4LogicalVolume(
+            layerS,        // its solid
+            calorMaterial, // its material
+            "Layer");      // its name
+
+        new G4PVReplica(
+            "Layer",         // its name
+            layerLV,         // its logical volume
+            calorLV,         // its mother
+            kYAxis,          // axis of replication
+            noLayers,        // number of replic
+            layerThickness); // width of replica
+
+        rodLV = new G4LogicalVolume(
+            layerS,        // its solid
+            calorMaterial, // its material
+            "Rod");        // its name
+
+        new G4PVReplica(
+            "Rod",    // its name
+            rodLV,    // its logical volume
+            layerLV,  // its mother
+            kXAxis,   // axis of replication
+            noRods,   // number of replic
+            rodSize); // witdth of replica
+    }
 
     //
     // Hole in a Rod
@@ -419,26 +754,26 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
     G4Material *core_S_Material = polystyrene;
 
     // Parameters for fibers
-    double clad_C_rMin = 0.39 * mm; // cladding cherenkov minimum radius
-    double clad_C_rMax = 0.40 * mm; // cladding cherenkov max radius
+    double clad_C_rMin = fLattice.fiberCoreRadius * mm; // cladding cherenkov minimum radius
+    double clad_C_rMax = fLattice.fiberRadius * mm; // cladding cherenkov max radius
     // double clad_C_Dz = fiberLength / 2.0; // cladding cherenkov lenght
     // double clad_C_Sphi = 0.;              // cladding cherenkov min rotation
     // double clad_C_Dphi = 2. * M_PI;       // cladding chrenkov max rotation
 
     double core_C_rMin = 0. * mm;
-    double core_C_rMax = 0.39 * mm;
+    double core_C_rMax = fLattice.fiberCoreRadius * mm;
     // double core_C_Dz = clad_C_Dz;
     // double core_C_Sphi = 0.;
     // double core_C_Dphi = 2. * M_PI;
 
-    double clad_S_rMin = 0.39 * mm;
-    double clad_S_rMax = 0.40 * mm;
+    double clad_S_rMin = fLattice.fiberCoreRadius * mm;
+    double clad_S_rMax = fLattice.fiberRadius * mm;
     // double clad_S_Dz = clad_C_Dz;
     // double clad_S_Sphi = 0.;
     // double clad_S_Dphi = 2. * M_PI;
 
     double core_S_rMin = 0. * mm;
-    double core_S_rMax = 0.39 * mm;
+    double core_S_rMax = fLattice.fiberCoreRadius * mm;
     // double core_S_Dz = clad_C_Dz;
     // double core_S_Sphi = 0.;
     // double core_S_Dphi = 2. * M_PI;
@@ -462,7 +797,7 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
     new G4PVPlacement(0, G4ThreeVector(0, 0, 0), fiberCoreCLog, "fiberCoreCherePhys", fiberCLog, false, 0);
     new G4PVPlacement(0, G4ThreeVector(0, 0, 0), fiberCoreSLog, "fiberCoreScintPhys", fiberSLog, false, 0);
 
-    double R = clad_C_rMax * 2.0 + 0.01; // 10 micron gap between cenral and peripheral fibers
+    double R = fLattice.fiberPitch * mm; // 10 micron gap between cenral and peripheral fibers
     double cx1 = R * cos(30.0 * deg);
     double cy1 = R * sin(30.0 * deg);
     new G4PVPlacement(0, G4ThreeVector(0., 0., 0.), fiberCLog, "fiberCladC", holeLV, false, 0, fCheckOverlaps);
@@ -479,6 +814,27 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
      fiberCoreSLog->SetSensitiveDetector(sd);
      }*/
 
+    if (fHybrid)
+    {
+        // homogenized rods: the materials of a detailed rod mixed by mass,
+        // so density and radiation length are those of the rod on average.
+        // The stepping action splits its deposits with the same parts.
+        G4double rodArea = rodSize * rodSize;
+        std::vector<RodPart> parts = RodParts();
+        G4double mass = 0.;
+        for (auto &part : parts)
+            mass += part.material->GetDensity() * part.area;
+        auto homogenized = new G4Material("Rod_Homogenized", mass / rodArea, int(parts.size()));
+        for (auto &part : parts)
+            homogenized->AddMaterial(part.material, part.material->GetDensity() * part.area / mass);
+        calorLV->SetMaterial(homogenized);
+
+        std::cout << "---> detailed rods " << fWindow[0] << "-" << fWindow[1] << " in layers " << fWindow[2] << "-"
+                  << fWindow[3] << ", others " << homogenized->GetName() << ": density "
+                  << homogenized->GetDensity() / (g / cm3) << " g/cm3, X0 " << homogenized->GetRadlen() / mm
+                  << " mm" << std::endl;
+    }
+
     //
     // print parameters
     //
@@ -488,22 +844,6 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
     std::cout << layerThickness / mm << "mm of (layer) " << calorMaterial->GetName() << std::endl;
     std::cout << "------------------------------------------------------------" << std::endl;
 
-    //
-    // Visualization attributes
-    //
-    // worldLV->SetVisAttributes (G4VisAttributes::GetInvisible());
-
-    worldLV->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(0.0, 0.0, 1.0, 0.5)));  // blue
-    calorLV->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(1.0, 0.0, 0.0, 0.1)));  // red
-    layerLV->SetVisAttributes(new G4VisAttributes(FALSE, G4Colour(0.0, 1.0, 0.0, 0.6))); // green
-    rodLV->SetVisAttributes(new G4VisAttributes(FALSE, G4Colour(0.0, 0.0, 0.0, 0.6)));   // blue
-    // holeLV->SetVisAttributes(new G4VisAttributes(FALSE,G4Colour(1.0,1.0,1.0))); // black
-    holeLV->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(1.0, 1.0, 1.0, 0.5))); // white
-    fiberCLog->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(0.8, 0.5, 0.8, 0.9)));
-    fiberCoreCLog->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(0.98, 0.5, 0.98, 0.9)));
-    fiberSLog->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(0.0, 0.5, 0.8, 0.9)));       // red
-    fiberCoreSLog->SetVisAttributes(new G4VisAttributes(TRUE, G4Colour(0.0, 0.98, 0.98, 0.9))); // red
-
     std::cout << "B4DetectorConstruction::DefineVolumes()...  ends..." << std::endl;
     //
     // Always return the physical World
@@ -513,6 +853,33 @@ G4VPhysicalVolume *B4DetectorConstruction::DefineVolumes()
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+void B4DetectorConstruction::SetVisAttributes()
+{
+    // by name: the volumes may come from DefineVolumes or from the cache.
+    auto store = G4LogicalVolumeStore::GetInstance();
+    auto setVis = [store](const char *name, G4bool visible, const G4Colour &colour)
+    {
+        G4LogicalVolume *lv = store->GetVolume(name, false);
+        if (lv)
+            lv->SetVisAttributes(new G4VisAttributes(visible, colour));
+    };
+
+    // worldLV->SetVisAttributes (G4VisAttributes::GetInvisible());
+
+    setVis("World", TRUE, G4Colour(0.0, 0.0, 1.0, 0.5));        // blue
+    setVis("Calorimeter", TRUE, G4Colour(1.0, 0.0, 0.0, 0.1));  // red
+    setVis("Layer", FALSE, G4Colour(0.0, 1.0, 0.0, 0.6));       // green
+    setVis("Rod", FALSE, G4Colour(0.0, 0.0, 0.0, 0.6));         // blue
+    // setVis("Hole", FALSE, G4Colour(1.0, 1.0, 1.0));          // black
+    setVis("Hole", TRUE, G4Colour(1.0, 1.0, 1.0, 0.5));         // white
+    setVis("fiberCladC", TRUE, G4Colour(0.8, 0.5, 0.8, 0.9));
+    setVis("fiberCoreC", TRUE, G4Colour(0.98, 0.5, 0.98, 0.9));
+    setVis("fiberCladS", TRUE, G4Colour(0.0, 0.5, 0.8, 0.9));   // red
+    setVis("fiberCoreS", TRUE, G4Colour(0.0, 0.98, 0.98, 0.9)); // red
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 void B4DetectorConstruction::ConstructSDandField()
 {
     std::cout << "B4DetectorConstruction::ConstructSDandField()... starts..." << std::endl;
@@ -30,9 +30,6 @@
 #include "B4PrimaryGeneratorAction.hh"
 
 #include "G4RunManager.hh"
-#include "G4LogicalVolumeStore.hh"
-#include "G4LogicalVolume.hh"
-#include "G4Box.hh"
 #include "G4Event.hh"
 #include "G4ParticleGun.hh"
 #include "G4ParticleTable.hh"
@@ -44,6 +41,8 @@
 #include "B4DetectorConstruction.hh"
 
 // for root tree
+#include "TChain.h"
+#include "TEnv.h"
 #include "TFile.h"
 #include "TTree.h"
 #include "TH1D.h"
@@ -54,6 +53,8 @@
 #include "Py8Jet.h"
 
 #include "CaloTree.h"
+#include "CaloBeamSampler.h"
+#include "CaloPythiaGenerator.h"
 
 using namespace std;
 
@@ -61,7 +62,8 @@ using namespace std;
 
 B4PrimaryGeneratorAction::B4PrimaryGeneratorAction(B4DetectorConstruction *det, CaloTree *histo)
     : G4VUserPrimaryGeneratorAction(),
-      fParticleGun(nullptr), fDetector(det), hh(histo)
+      fParticleGun(nullptr), fDetector(det), hh(histo), gunParticle(nullptr), beamSampler(nullptr),
+      py8chain(nullptr), py8evt(nullptr), pythiaGenerator(nullptr)
 {
   cout << "B4PrimaryGeneratorAction constructer is called..." << endl;
   // Create the table containing all particle names
@@ -69,31 +71,85 @@ B4PrimaryGeneratorAction::B4PrimaryGeneratorAction(B4DetectorConstruction *det,
 
   getParamFromEnvVars(); // get paramters from theenvvariables.
 
-  if (CaloXPythiaON == 1)
+  if (CaloXPythiaON == 2)
+  {
+    // events generated here, no py8tree files
+    py8eventCounter = 0;
+    pythiaGenerator = new CaloPythiaGenerator(CaloXPythiaCard);
+  }
+  else if (CaloXPythiaON == 1)
   {
     py8eventCounter = 0;
     py8eventNumber = CaloXPythiaSkip;
-    string inFileName = CaloXPythiaFile;
-    std::cout << "B4PrimaryGeneratorAction:  Using Pythia Event file: " << inFileName << std::endl;
-    finPy8 = new TFile(inFileName.c_str());
-    TTree *py8tree;
-    finPy8->GetObject("py8tree", py8tree);
-    py8evt = new Py8Jet(py8tree);
-    py8evt->Init(py8tree);
-    std::cout << "B4PrimaryGeneratorAction: nentries=" << py8tree->GetEntriesFast() << std::endl;
+    if (hh->resumePy8Event() >= 0)
+      py8eventNumber = hh->resumePy8Event(); // -resume true
+    if (hh->replayEventNumber() > 0)
+      py8eventNumber = CaloXPythiaSkip + hh->replayEventNumber() - 1; // -replayEvent N
+    // one file, a glob, a comma separated list or a .txt/.list file of them
+    std::cout << "B4PrimaryGeneratorAction:  Using Pythia Event files: " << CaloXPythiaFile << std::endl;
+    if (CaloXPythiaPrefetch == 1)
+      gEnv->SetValue("TFile.AsyncPrefetching", 1); // read-ahead thread, before the files are opened
+    py8chain = new TChain("py8tree");
+    int nFiles = Py8Jet::AddFiles(py8chain, CaloXPythiaFile);
+    if (nFiles == 0)
+    {
+      std::cout << "B4PrimaryGeneratorAction: no py8tree files in " << CaloXPythiaFile << ". Exit.." << std::endl;
+      std::exit(0);
+    }
+    py8evt = new Py8Jet(py8chain);
+    py8evt->SelectBranches();
+    py8evt->SetCache(Long64_t(CaloXPythiaCacheMB) * 1024 * 1024, py8eventNumber);
+    std::cout << "B4PrimaryGeneratorAction: files=" << nFiles << "  cache=" << CaloXPythiaCacheMB << " MB"
+              << "  prefetch=" << CaloXPythiaPrefetch << std::endl;
   }
   else
   {
     G4int nofParticles = 1;
     fParticleGun = new G4ParticleGun(nofParticles);
 
-    // default particle kinematic
-    //
-    auto particleDefinition = G4ParticleTable::GetParticleTable()->FindParticle("e-");
-    fParticleGun->SetParticleDefinition(particleDefinition);
-    fParticleGun->SetParticleMomentumDirection(G4ThreeVector(0., 0., 1.));
-    fParticleGun->SetParticleEnergy(50. * MeV);
+    // the beam of the whole job, resolved once: particle, ranges, direction
+    gunParticleName = hh->getParamS("gun_particle");
+    gunParticle = particleTable->FindParticle(gunParticleName);
+    if (!gunParticle)
+    {
+      std::cout << "B4PrimaryGeneratorAction: unknown gun_particle " << gunParticleName << ". Exit.." << std::endl;
+      std::exit(0);
+    }
+    CaloBeamSampler::Config beam;
+    const char *lo[4] = {"gun_x_min", "gun_y_min", "gun_z_min", "gun_energy_min"};
+    const char *hi[4] = {"gun_x_max", "gun_y_max", "gun_z_max", "gun_energy_max"};
+    for (int i = 0; i < 4; i++)
+    {
+      beam.min[i] = hh->getParamF(lo[i]);
+      beam.max[i] = hh->getParamF(hi[i]);
+    }
+    beam.direction[0] = hh->getParamF("pMomentum_x");
+    beam.direction[1] = hh->getParamF("pMomentum_y");
+    beam.direction[2] = hh->getParamF("pMomentum_z");
+    string spot = hh->getParamS("beamSpot");
+    if (spot != "flat" && spot != "gauss")
+    {
+      std::cout << "B4PrimaryGeneratorAction: beamSpot must be flat or gauss, not " << spot << ". Exit.." << std::endl;
+      std::exit(0);
+    }
+    beam.gaussSpot = spot == "gauss";
+    beam.sigmaX = hh->getParamF("beamSigmaX");
+    beam.sigmaY = hh->getParamF("beamSigmaY");
+    beam.angleX = hh->getParamF("beamAngleX");
+    beam.angleY = hh->getParamF("beamAngleY");
+    beam.divergenceX = hh->getParamF("beamDivergenceX");
+    beam.divergenceY = hh->getParamF("beamDivergenceY");
+    beam.energySpread = hh->getParamF("beamEnergySpread");
+    beam.spectrumFile = hh->getParamS("beamSpectrum");
+    beam.settingsFile = hh->getParamS("beamSettings");
+    beamSampler = new CaloBeamSampler(beam);
+    beamSampler->print();
+    beamDraws.resize(beamSampler->draws());
+    fParticleGun->SetParticleDefinition(gunParticle);
   }
+
+  // extents from the same lattice (mac file) the detector is built from
+  worldZHalfLength = 0.5 * fDetector->GetLattice().worldSizeZ() * mm;
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -101,6 +157,8 @@ B4PrimaryGeneratorAction::B4PrimaryGeneratorAction(B4DetectorConstruction *det,
 B4PrimaryGeneratorAction::~B4PrimaryGeneratorAction()
 {
   delete fParticleGun;
+  delete beamSampler;
+  delete pythiaGenerator;
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -109,94 +167,38 @@ void B4PrimaryGeneratorAction::GeneratePrimaries(G4Event *anEvent)
 {
   // cout<<"B4PrimaryGeneratorAction::GeneratePrimaries is called..."<<endl;
   // This function is called at the begining of event
+  hh->seedEvent();
 
-  // In order to avoid dependence of PrimaryGeneratorAction
-  // on DetectorConstruction class we get world volume
-  // from G4LogicalVolumeStore
-  //
-  worldZHalfLength = 0.;
-  auto worldLV = G4LogicalVolumeStore::GetInstance()->GetVolume("World");
-
-  // Check that the world volume has box shape
-  G4Box *worldBox = nullptr;
-  if (worldLV)
-  {
-    worldBox = dynamic_cast<G4Box *>(worldLV->GetSolid());
-  }
-
-  if (worldBox)
+  if (CaloXPythiaON == 2)
   {
-    worldZHalfLength = worldBox->GetZHalfLength();
+    getPythiaEvent(anEvent);
   }
-  else
-  {
-    G4ExceptionDescription msg;
-    msg << "World volume of box shape not found." << G4endl;
-    msg << "Perhaps you have changed geometry." << G4endl;
-    msg << "The gun will be place in the center.";
-    G4Exception("B4PrimaryGeneratorAction::GeneratePrimaries()",
-                "MyCode0002", JustWarning, msg);
-  }
-
-  // The size of Calorimeter volume
-
-  double calorimeterZHalfLength = 0.;
-  auto calorimeterLV = G4LogicalVolumeStore::GetInstance()->GetVolume("Calorimeter");
-
-  // Check that the world volume has box shape
-  G4Box *calorimeterBox = nullptr;
-  if (calorimeterLV)
-  {
-    calorimeterBox = dynamic_cast<G4Box *>(calorimeterLV->GetSolid());
-  }
-
-  if (calorimeterBox)
-  {
-    calorimeterZHalfLength = calorimeterBox->GetZHalfLength();
-  }
-  else
-  {
-    G4ExceptionDescription msg;
-    msg << "Calorimeter volume of box shape not found." << G4endl;
-    msg << "Perhaps you have changed geometry." << G4endl;
-    msg << "The gun will be place in the center.";
-    G4Exception("B4PrimaryGeneratorAction::GeneratePrimaries()",
-                "MyCode0002", JustWarning, msg);
-  }
-
-  if (CaloXPythiaON == 1)
+  else if (CaloXPythiaON == 1)
   {
     getPy8Event(anEvent);
   }
   else
   {
-    double r1 = G4UniformRand();
-    double r2 = G4UniformRand();
-    double r3 = G4UniformRand();
-    float x = ((hh->getParamF("gun_x_max") - hh->getParamF("gun_x_min")) * G4UniformRand() + hh->getParamF("gun_x_min")) * cm;
-    float y = ((hh->getParamF("gun_y_max") - hh->getParamF("gun_y_min")) * G4UniformRand() + hh->getParamF("gun_y_min")) * cm;
-    float z = ((hh->getParamF("gun_z_max") - hh->getParamF("gun_z_min")) * G4UniformRand() + hh->getParamF("gun_z_min")) * cm;
+    // one batch of draws per event, as many as the beam model needs
+    G4Random::getTheEngine()->flatArray(int(beamDraws.size()), beamDraws.data());
+    CaloBeamSampler::Beam beam;
+    beamSampler->sample(beamDraws.data(), beam);
+    float x = beam.x * cm;
+    float y = beam.y * cm;
+    float z = beam.z * cm;
     // float z = -calorimeterZHalfLength - 50.0;
 
-    float en = ((hh->getParamF("gun_energy_max") - hh->getParamF("gun_energy_min")) * G4UniformRand() + hh->getParamF("gun_energy_min")) * GeV;
-    string ptype = hh->getParamS("gun_particle");
-    float px = (hh->getParamF("pMomentum_x"));
-    float py = (hh->getParamF("pMomentum_y"));
-    float pz = (hh->getParamF("pMomentum_z"));
-
-    G4int nofParticles = 1;
-    fParticleGun = new G4ParticleGun(nofParticles);
+    float en = beam.energy * GeV;
 
-    auto particleDefinition = G4ParticleTable::GetParticleTable()->FindParticle(ptype);
-    fParticleGun->SetParticleDefinition(particleDefinition);
+    // the gun of the job: the particle is set already
     fParticleGun->SetParticlePosition(G4ThreeVector(x, y, z));
+    fParticleGun->SetParticleMomentumDirection(G4ThreeVector(beam.dx, beam.dy, beam.dz));
     fParticleGun->SetParticleEnergy(en);
-    fParticleGun->SetParticleMomentumDirection(G4ThreeVector(px, py, pz));
     fParticleGun->GeneratePrimaryVertex(anEvent);
     // cout<<"B4PrimaryGeneratorAction::GeneratePrimaries set a particle..."<<endl;
-    // cout<<"   (x,y,z,en)="<<x<<",  "<<y<<",  "<<z<<",  "<<en<<",  "<<ptype<<endl;
-    int pdgid = particleDefinition->GetPDGEncoding();
-    hh->saveBeamXYZE(ptype, pdgid, x, y, z, en);
+    // cout<<"   (x,y,z,en)="<<x<<",  "<<y<<",  "<<z<<",  "<<en<<",  "<<gunParticleName<<endl;
+    hh->saveBeamXYZE(gunParticleName, gunParticle->GetPDGEncoding(), x, y, z, en);
+    hh->saveBeamDirection(beam.dx, beam.dy, beam.dz);
   }
 }
 
@@ -283,6 +285,30 @@ void B4PrimaryGeneratorAction::getParamFromEnvVars()
     CaloXPythiaFile = std::string(param10);
   }
 
+  CaloXPythiaCacheMB = 32; // TTreeCache, 0=off
+  CaloXPythiaPrefetch = 1; // asynchronous read-ahead
+
+  char *param11;
+  param11 = getenv("CaloXPythiaCacheMB");
+  if (param11 != NULL)
+  {
+    CaloXPythiaCacheMB = atoi(param11);
+  }
+
+  char *param12;
+  param12 = getenv("CaloXPythiaPrefetch");
+  if (param12 != NULL)
+  {
+    CaloXPythiaPrefetch = atoi(param12);
+  }
+
+  char *param13;
+  param13 = getenv("CaloXPythiaCard");
+  if (param13 != NULL)
+  {
+    CaloXPythiaCard = std::string(param13);
+  }
+
   return;
 }
 
@@ -290,31 +316,21 @@ void B4PrimaryGeneratorAction::getParamFromEnvVars()
 void B4PrimaryGeneratorAction::getPy8Event(G4Event *anEvent)
 {
 
-  py8evt->GetEntry(py8eventNumber);
+  py8evt->GetEntry(py8eventNumber); // the branches of Py8Jet::SelectBranches
   if (py8eventCounter < CaloXPythiaPrint)
+  {
+    py8evt->ReadAll();
     printPy8Event();
+  }
 
   py8eventCounter++;
   py8eventNumber++;
+  hh->setPy8Event(py8eventNumber);
   // std::cout<<"B4PrimaryGeneratorAction::getPy8Event  after py8evt->GetEntry="<<std::endl;
   // std::cout<<"py8evt->pid->size()  "<<py8evt->pid->size()<<std::endl;
   // std::cout<<"    pid=py8evt->pid->at(i) ="<<py8evt->pid->at(0)<<std::endl;
 
-  G4ParticleGun mygun;
-  double r1 = CLHEP::RandFlat::shoot();
-  double r2 = CLHEP::RandFlat::shoot();
-  double r3 = CLHEP::RandFlat::shoot();
-  double x = CaloXPythiaXmin + (CaloXPythiaXmax - CaloXPythiaXmin) * r1;
-  double y = CaloXPythiaYmin + (CaloXPythiaYmax - CaloXPythiaYmin) * r2;
-  double z = CaloXPythiaZmin + (CaloXPythiaZmax - CaloXPythiaZmin) * r3;
-  if (z < -worldZHalfLength)
-    z = -worldZHalfLength + 0.0001; // limit to the World volume.
-  double t = 0.0;
-
-  // std::cout<<"B4PrimaryGeneratorAction::getPy8Event  x="<<x
-  //<<"   CaloXPythiaXmin "<<CaloXPythiaXmin<<"  max "<<CaloXPythiaXmax<<std::endl;
-
-  G4PrimaryVertex *vertex = new G4PrimaryVertex(G4ThreeVector(x, y, z), t);
+  G4PrimaryVertex *vertex = pythiaVertex();
 
   for (int i = 0; i < py8evt->pid->size(); i++)
   {
@@ -338,6 +354,53 @@ void B4PrimaryGeneratorAction::getPy8Event(G4Event *anEvent)
   // std::cout<<"B4PrimaryGeneratorAction::getPy8Event:"<<primary->GetMomentum()<<std::endl;
 }
 
+// -----------------------------------------------------------------------------
+void B4PrimaryGeneratorAction::getPythiaEvent(G4Event *anEvent)
+{
+  // the Pythia seed is the first draw of the event: with eventSeeding
+  // event it depends on runNumber, runSeq and the event number only
+  int seed = 1 + int(G4Random::getTheEngine()->flat() * (CaloPythiaGenerator::kMaxSeed - 1));
+  if (!pythiaGenerator->generate(seed, pythiaParticles))
+  {
+    std::cout << "B4PrimaryGeneratorAction: Pythia failed on seed " << seed << ", event without primaries"
+              << std::endl;
+    return;
+  }
+  if (py8eventCounter < CaloXPythiaPrint)
+    pythiaGenerator->list();
+  py8eventCounter++;
+
+  G4PrimaryVertex *vertex = pythiaVertex();
+  for (auto &p : pythiaParticles)
+  {
+    G4ParticleDefinition *particle_definition = particleTable->FindParticle(p.pid);
+    if (!particle_definition)
+      continue; // not known to Geant4
+    vertex->SetPrimary(new G4PrimaryParticle(particle_definition, p.px * GeV, p.py * GeV, p.pz * GeV));
+  }
+  anEvent->AddPrimaryVertex(vertex);
+}
+
+// -----------------------------------------------------------------------------
+G4PrimaryVertex *B4PrimaryGeneratorAction::pythiaVertex()
+{
+  // vertex point of the Pythia event, smeared by CaloXPythiaX/Y/Zmin..max
+  double r1 = CLHEP::RandFlat::shoot();
+  double r2 = CLHEP::RandFlat::shoot();
+  double r3 = CLHEP::RandFlat::shoot();
+  double x = CaloXPythiaXmin + (CaloXPythiaXmax - CaloXPythiaXmin) * r1;
+  double y = CaloXPythiaYmin + (CaloXPythiaYmax - CaloXPythiaYmin) * r2;
+  double z = CaloXPythiaZmin + (CaloXPythiaZmax - CaloXPythiaZmin) * r3;
+  if (z < -worldZHalfLength)
+    z = -worldZHalfLength + 0.0001; // limit to the World volume.
+  double t = 0.0;
+
+  // std::cout<<"B4PrimaryGeneratorAction::getPy8Event  x="<<x
+  //<<"   CaloXPythiaXmin "<<CaloXPythiaXmin<<"  max "<<CaloXPythiaXmax<<std::endl;
+
+  return new G4PrimaryVertex(G4ThreeVector(x, y, z), t);
+}
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 void B4PrimaryGeneratorAction::printPy8Event()
@@ -388,6 +451,7 @@ void B4PrimaryGeneratorAction::FillHEPparticles(
   if (py8evt == NULL)
     return;
 
+  py8evt->ReadAll();
   int n = py8evt->pid->size();
   for (int i = 0; i < n; i++)
   {
@@ -0,0 +1,131 @@
+/// \file B4ReadoutWorld.cc
+/// \brief Implementation of the B4ReadoutWorld class
+
+#include "B4ReadoutWorld.hh"
+
+#include "G4Box.hh"
+#include "G4LogicalVolume.hh"
+#include "G4PVPlacement.hh"
+#include "G4PVReplica.hh"
+#include "G4SDManager.hh"
+#include "G4Step.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4Track.hh"
+#include "G4VTouchable.hh"
+
+#include <cmath>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B4ReadoutSD::B4ReadoutSD(const G4String &name)
+    : G4VSensitiveDetector(name),
+      track(nullptr), stepNumber(-1), ix(0), iy(0), iz(0)
+{
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B4ReadoutSD::ProcessHits(G4Step *step, G4TouchableHistory *)
+{
+  // the step of the parallel world: its touchable is the readout cell.
+  // called before the stepping action of the same step.
+  auto touchable = step->GetPreStepPoint()->GetTouchable();
+  track = step->GetTrack();
+  stepNumber = track->GetCurrentStepNumber();
+  iz = touchable->GetReplicaNumber(0);
+  iy = touchable->GetReplicaNumber(1);
+  ix = touchable->GetReplicaNumber(2);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B4ReadoutWorld::B4ReadoutWorld(const G4String &name, const CaloLattice &lattice, G4int rodsPerChannel,
+                               G4int layersPerChannel, G4double sliceZ, G4double rotationX,
+                               G4double rotationY)
+    : G4VUserParallelWorld(name),
+      fLattice(lattice),
+      fRodsPerChannel(rodsPerChannel),
+      fLayersPerChannel(layersPerChannel),
+      fSliceZ(sliceZ),
+      fRotationX(rotationX),
+      fRotationY(rotationY),
+      fSD(nullptr)
+{
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B4ReadoutWorld::~B4ReadoutWorld()
+{
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4ReadoutWorld::Construct()
+{
+  G4VPhysicalVolume *ghostWorld = GetWorld();
+  G4LogicalVolume *worldLV = ghostWorld->GetLogicalVolume();
+
+  // whole channels and slices: the last ones may stick out of the calorimeter
+  G4int nX = (fLattice.nRods + fRodsPerChannel - 1) / fRodsPerChannel;
+  G4int nY = (fLattice.nLayers + fLayersPerChannel - 1) / fLayersPerChannel;
+  G4int nZ = G4int(std::ceil(fLattice.length / fSliceZ - 1e-9));
+  G4double cellX = fRodsPerChannel * fLattice.rodSize * mm;
+  G4double cellY = fLayersPerChannel * fLattice.rodSize * mm;
+  G4double cellZ = fSliceZ * mm;
+
+  // no materials: navigation only
+  auto readoutS = new G4Box("Readout", nX * cellX / 2., nY * cellY / 2., nZ * cellZ / 2.);
+  auto readoutLV = new G4LogicalVolume(readoutS, nullptr, "Readout");
+
+  // same frame as the calorimeter; the box starts at its first rod, layer
+  // and at its front face
+  G4RotationMatrix *rot = new G4RotationMatrix;
+  rot->rotateX(fRotationX * deg);
+  rot->rotateY(fRotationY * deg);
+  G4ThreeVector offset((nX * cellX - fLattice.sizeX() * mm) / 2., (nY * cellY - fLattice.sizeY() * mm) / 2.,
+                       (nZ * cellZ - fLattice.sizeZ() * mm) / 2.);
+  new G4PVPlacement(rot, rot->inverse() * offset, readoutLV, "Readout", worldLV, false, 0);
+
+  auto columnS = new G4Box("ReadoutColumn", cellX / 2., nY * cellY / 2., nZ * cellZ / 2.);
+  auto columnLV = new G4LogicalVolume(columnS, nullptr, "ReadoutColumn");
+  new G4PVReplica("ReadoutColumn", columnLV, readoutLV, kXAxis, nX, cellX);
+
+  auto channelS = new G4Box("ReadoutChannel", cellX / 2., cellY / 2., nZ * cellZ / 2.);
+  auto channelLV = new G4LogicalVolume(channelS, nullptr, "ReadoutChannel");
+  new G4PVReplica("ReadoutChannel", channelLV, columnLV, kYAxis, nY, cellY);
+
+  auto sliceS = new G4Box("ReadoutSlice", cellX / 2., cellY / 2., cellZ / 2.);
+  auto sliceLV = new G4LogicalVolume(sliceS, nullptr, "ReadoutSlice");
+  new G4PVReplica("ReadoutSlice", sliceLV, channelLV, kZAxis, nZ, cellZ);
+
+  std::cout << "B4ReadoutWorld: " << nX << " x " << nY << " channels of " << fRodsPerChannel << " x "
+            << fLayersPerChannel << " rods, " << nZ << " slices of " << fSliceZ << " mm" << std::endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4ReadoutWorld::ConstructSD()
+{
+  fSD = new B4ReadoutSD("ReadoutSD");
+  G4SDManager::GetSDMpointer()->AddNewDetector(fSD);
+  SetSensitiveDetector("ReadoutSlice", fSD);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B4ReadoutWorld::cell(const G4Track *track, G4int &ix, G4int &iy, G4int &iz)
+{
+  // only if the readout saw this very step; read once, so a later track at
+  // the same address never gets the cell of an earlier one
+  if (!fSD || fSD->track != track || fSD->stepNumber != track->GetCurrentStepNumber())
+    return false;
+  fSD->track = nullptr;
+  ix = fSD->ix;
+  iy = fSD->iy;
+  iz = fSD->iz;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -34,11 +34,19 @@
 #include "G4UnitsTable.hh"
 #include "G4SystemOfUnits.hh"
 
+#include <algorithm>
+
+#include "B4bSteppingAction.hh"
+#include "CaloPhysicsCache.h"
+#include "CaloTree.h"
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B4bRunAction::B4bRunAction(CaloTree *histo)
     : G4UserRunAction(),
-      hh(histo)
+      hh(histo),
+      physicsCache(nullptr),
+      steppingAction(nullptr)
 {
   // set printing event number per each event
   G4RunManager::GetRunManager()->SetPrintProgress(1);
@@ -55,13 +63,27 @@ B4bRunAction::~B4bRunAction()
 void B4bRunAction::BeginOfRunAction(const G4Run *run)
 {
   std::cout << "### Run " << run->GetRunID() << " start." << std::endl;
+  if (physicsCache)
+    physicsCache->tablesReady(); // built or retrieved by now
+  if (steppingAction)
+    steppingAction->resetCounts();
+  runStart = std::chrono::steady_clock::now();
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 void B4bRunAction::EndOfRunAction(const G4Run * /*aRun*/)
 {
-  // print histogram statistics
+  // step rates of the event loop, to compare geometryNavigation modes
+  if (steppingAction)
+  {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    long all = steppingAction->steps();
+    long optical = steppingAction->opticalSteps();
+    std::cout << "B4bRunAction: " << all << " steps (" << optical << " optical photon) in " << seconds
+              << " s, " << all / std::max(seconds, 1e-9) << " steps/s, geometryNavigation "
+              << hh->getParamS("geometryNavigation") << std::endl;
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
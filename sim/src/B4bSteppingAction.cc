@@ -32,8 +32,11 @@
 
 #include "B4bSteppingAction.hh"
 #include "B4DetectorConstruction.hh"
+#include "B4ReadoutWorld.hh"
 
 #include "G4Step.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
 #include "G4RunManager.hh"
 #include "G4UnitsTable.hh"
 #include "G4Triton.hh"
@@ -51,12 +54,21 @@
 
 #include "TH1D.h"
 
+#include <cstdio>
+#include <cstdlib>
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-B4bSteppingAction::B4bSteppingAction(B4bEventAction *eventAction, CaloTree *histo)
+B4bSteppingAction::B4bSteppingAction(B4bEventAction *eventAction, B4DetectorConstruction *detector, CaloTree *histo)
     : G4UserSteppingAction(),
       fEventAction(eventAction),
-      hh(histo)
+      hh(histo),
+      lattice(detector->GetLattice()),
+      hybrid(detector->IsHybrid()),
+      rodMix(detector->GetRodMix()),
+      readout(detector->GetReadoutWorld()),
+      nSteps(0),
+      nOpticalSteps(0)
 {
   // initialize SiPM PDE
   int sipmType = histo->getParamI("sipmType");
@@ -64,6 +76,37 @@ B4bSteppingAction::B4bSteppingAction(B4bEventAction *eventAction, CaloTree *hist
 
   std::cout << "  " << std::endl;
   std::cout << "sipmType " << sipmType << " in B4bSteppingAction::B4bSteppingAction" << std::endl;
+
+  // opWindow: the rods whose fibers propagate optical photons, the others
+  // kill them (fillOPInfo). center: the centre cell of the lattice.
+  std::string window = histo->getParamS("opWindow");
+  if (window == "center")
+  {
+    opWindow[0] = opWindow[1] = lattice.nRods / 2;
+    opWindow[2] = opWindow[3] = lattice.nLayers / 2;
+  }
+  else if (std::sscanf(window.c_str(), "%d:%d,%d:%d", &opWindow[0], &opWindow[1], &opWindow[2], &opWindow[3]) != 4 ||
+           opWindow[0] > opWindow[1] || opWindow[2] > opWindow[3])
+  {
+    std::cout << "B4bSteppingAction: bad opWindow " << window << " (center, or rodMin:rodMax,layerMin:layerMax). Exit.."
+              << std::endl;
+    std::exit(0);
+  }
+  // only detailed rods have fibers
+  const int *detailed = detector->GetDetailWindow();
+  int rodMax = hybrid ? detailed[1] : lattice.nRods - 1;
+  int layerMax = hybrid ? detailed[3] : lattice.nLayers - 1;
+  int rodMin = hybrid ? detailed[0] : 0;
+  int layerMin = hybrid ? detailed[2] : 0;
+  if (opWindow[0] < rodMin || opWindow[1] > rodMax || opWindow[2] < layerMin || opWindow[3] > layerMax)
+  {
+    std::cout << "B4bSteppingAction: opWindow " << window << " is outside the rods with fibers, " << rodMin << ":"
+              << rodMax << "," << layerMin << ":" << layerMax << ". Exit.." << std::endl;
+    std::exit(0);
+  }
+  std::cout << "opWindow " << opWindow[0] << ":" << opWindow[1] << "," << opWindow[2] << ":" << opWindow[3]
+            << " in B4bSteppingAction::B4bSteppingAction" << std::endl;
+
   for (int i = 200; i < 900; i = i + 10)
   {
     float lambda = float(i) + 0.5;
@@ -92,11 +135,13 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
       G4OpticalPhoton::OpticalPhotonDefinition();
 
   const G4DynamicParticle *dynamicParticle = track->GetDynamicParticle();
+  nSteps++;
   const G4ParticleDefinition *particleDef =
       dynamicParticle->GetParticleDefinition();
 
   if (particleDef == opticalphoton)
   {
+    nOpticalSteps++;
     fillOPInfo(step, false);
   }
   //   === end of checking optical photon ===
@@ -111,8 +156,7 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
   auto edepNonIon = step->GetNonIonizingEnergyDeposit();
   double charge = track->GetDefinition()->GetPDGCharge();
 
-  G4int pdgcode = dynamicParticle->GetPDGcode();
-  // G4int absPdgCode=abs(pdgcode);
+  // G4int absPdgCode=abs(dynamicParticle->GetPDGcode());
   G4ParticleDefinition *particle = dynamicParticle->GetDefinition();
   G4String particleName = particle->GetParticleName();
   G4double kinEnergy = dynamicParticle->GetKineticEnergy();
@@ -124,7 +168,6 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
   auto thisPhysical = touchable->GetVolume(); // mother
   auto thisCopyNo = thisPhysical->GetCopyNo();
   auto thisName = thisPhysical->GetName();
-  G4ThreeVector posA = step->GetPreStepPoint()->GetPosition();
 
   double birks = 1.0;
   vector<double> ncer;
@@ -170,12 +213,21 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
     caloType = 1;
     fiberNumber = -1;
     holeNumber = 0;
-    rodNumber = touchable->GetCopyNumber(0);
-    layerNumber = touchable->GetCopyNumber(1);
+    locateCell(step, layerNumber, rodNumber);
     // holeReplicaNumber=touchable->GetReplicaNumber(2);
     // rodReplicaNumber=touchable->GetReplicaNumber(3);
     // layerReplicaNumber=touchable->GetReplicaNumber(4);
   }
+  bool homogenized = false;
+  if (hybrid && thisName.compare(0, 11, "Calorimeter") == 0)
+  {
+    // homogenized rods: the deposit goes to the lattice cell, split into
+    // the parts of a detailed rod (bookHomogenized)
+    fiberNumber = -1;
+    holeNumber = 0;
+    locateCell(step, layerNumber, rodNumber);
+    homogenized = rodNumber >= 0;
+  }
   if (thisName.compare(0, 18, "fiberCoreScintPhys") == 0)
   {
     caloType = 2;
@@ -189,14 +241,9 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
 
   if (caloType == 2 || caloType == 3)
   {
-    // todo: there might be better ways to get these information.
-    // 0 is core number,
-    // 1 is fiber/clad nummber (since core is in clad)
-    // 2 is hole, 3 is rod, 4 is layer
-    fiberNumber = touchable->GetCopyNumber(1);
-    holeNumber = touchable->GetCopyNumber(2);
-    rodNumber = touchable->GetCopyNumber(3);
-    layerNumber = touchable->GetCopyNumber(4);
+    // analytic from the position: the same for all geometryNavigation
+    fiberNumber = locateCell(step, layerNumber, rodNumber);
+    holeNumber = 0;
     // holeReplicaNumber=touchable->GetReplicaNumber(2);
     // rodReplicaNumber=touchable->GetReplicaNumber(3);
     // layerReplicaNumber=touchable->GetReplicaNumber(4);
@@ -209,9 +256,42 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
   //  std::cout<<" "<<std::endl;
   // std::cout<<" replicas "<<holeReplicaNumber<<"  "<<rodReplicaNumber<<"  "<<layerReplicaNumber<<std::endl;
 
+  if (homogenized)
+    bookHomogenized(step, layerNumber, rodNumber, edep);
+  else if (ncer.size() > 0)
+    bookDeposit(step, caloType, fiberNumber, layerNumber, rodNumber, edep, birks, ncer[0], ncer[3]);
+  else
+    bookDeposit(step, caloType, fiberNumber, layerNumber, rodNumber, edep, birks, 0., 0.);
+
+  // hh->histo1D["edepX"]->Fill(aHit.x/10.0,edep);
+  // hh->histo1D["edepY"]->Fill(aHit.y/10.0,edep);
+  // hh->histo1D["cerX"]->Fill(aHit.x/10.0,ncer[0]);
+  // hh->histo1D["cerY"]->Fill(aHit.y/10.0,ncer[0]);
+
+  // fEventAction->AccumulateCaloHits(aHit);
+  // fEventAction->StepAnalysisSensor(step,ncer);   // analysis for the sensor volume.
+
+  // fEventAction->StepAnalysis(step,ncer[0],ncer[1]);   // in original sim. Moved to above.
+} // end of B4bSteppingAction::UserSteppingAction.
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4bSteppingAction::bookDeposit(const G4Step *step, int caloType, int fiberNumber, int layerNumber,
+                                    int rodNumber, double edep, double birks, double ncer, double ncercap)
+{
+  G4Track *track = step->GetTrack();
+  G4int pdgcode = track->GetDynamicParticle()->GetPDGcode();
+  G4ThreeVector posA = step->GetPreStepPoint()->GetPosition();
+
   hh->accumulateEnergy(edep / GeV, caloType);
 
-  CaloID caloid(caloType, fiberNumber, layerNumber, rodNumber, posA.z(), track->GetGlobalTime());
+  // channel and slice from the readout world if there is one, else from
+  // rod and layer numbers
+  int readoutIx, readoutIy, readoutIz;
+  CaloID caloid = (readout && readout->cell(track, readoutIx, readoutIy, readoutIz))
+                      ? CaloID(caloType, fiberNumber, layerNumber, rodNumber, posA.z(), track->GetGlobalTime(),
+                               readoutIx, readoutIy, readoutIz)
+                      : CaloID(caloType, fiberNumber, layerNumber, rodNumber, posA.z(), track->GetGlobalTime());
 
   CaloHit aHit;
   aHit.caloid = caloid;
@@ -237,26 +317,113 @@ void B4bSteppingAction::UserSteppingAction(const G4Step *step)
   aHit.steplength = track->GetTrackLength() / cm;
   aHit.edep = edep / GeV; //  in GeV
   aHit.edepbirk = edep * birks / GeV;
-  if (ncer.size() > 0)
-  {
-    aHit.ncer = ncer[0];
-    aHit.ncercap = ncer[3]; // including SiPM pde and capturing efficiency
-  }
+  aHit.ncer = ncer;
+  aHit.ncercap = ncercap; // including SiPM pde and capturing efficiency
 
   // aHit.print();
 
   hh->accumulateHits(aHit);
+}
 
-  // hh->histo1D["edepX"]->Fill(aHit.x/10.0,edep);
-  // hh->histo1D["edepY"]->Fill(aHit.y/10.0,edep);
-  // hh->histo1D["cerX"]->Fill(aHit.x/10.0,ncer[0]);
-  // hh->histo1D["cerY"]->Fill(aHit.y/10.0,ncer[0]);
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-  // fEventAction->AccumulateCaloHits(aHit);
-  // fEventAction->StepAnalysisSensor(step,ncer);   // analysis for the sensor volume.
+void B4bSteppingAction::bookHomogenized(const G4Step *step, int layerNumber, int rodNumber, double edep)
+{
+  // a step in a homogenized rod: the deposit by mass, the path in the
+  // fibers by area of the parts of a detailed rod, so the channel sums do
+  // not depend on the detailWindow.
+  const double *mass = rodMix.massShare;
+  const double *area = rodMix.areaShare;
+
+  // S cores: Birks with the dE/dx in the core, as getBirk for polystyrene
+  double edepS = edep * mass[2];
+  double birks = 1.0;
+  if (rodMix.coreS->GetName().compare(0, 11, "Polystyrene") == 0)
+    birks = getBirkHC(edepS, step->GetStepLength() * area[2] / CLHEP::cm,
+                      step->GetTrack()->GetDefinition()->GetPDGCharge(),
+                      rodMix.coreS->GetDensity() / (CLHEP::g / CLHEP::cm3));
+
+  // C cores: Cherenkov photons of the path in the cores
+  double ncer, ncercap;
+  homogenizedCerenkov(step, step->GetStepLength() * area[3], ncer, ncercap);
+
+  bookDeposit(step, 1, -1, layerNumber, rodNumber, edep * mass[1], 1.0, 0., 0.);
+  bookDeposit(step, 2, -1, layerNumber, rodNumber, edepS, birks, 0., 0.);
+  bookDeposit(step, 3, -1, layerNumber, rodNumber, edep * mass[3], 1.0, ncer, ncercap);
+  bookDeposit(step, 0, -1, layerNumber, rodNumber, edep * mass[0], 1.0, 0., 0.); // hole and claddings
+}
 
-  // fEventAction->StepAnalysis(step,ncer[0],ncer[1]);   // in original sim. Moved to above.
-} // end of B4bSteppingAction::UserSteppingAction.
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B4bSteppingAction::homogenizedCerenkov(const G4Step *step, double path, double &ncer, double &ncercap)
+{
+  // mean number of photons (Frank-Tamm) in the C core material, and of
+  // those within the acceptance of UserCerenkov (theta < 0.336) weighted
+  // with the SiPM PDE: the cone around the step direction at cos = 1/(beta n).
+  ncer = ncercap = 0.;
+  double charge = step->GetTrack()->GetDefinition()->GetPDGCharge() / eplus;
+  G4MaterialPropertiesTable *mpt = rodMix.coreC->GetMaterialPropertiesTable();
+  G4MaterialPropertyVector *rindex = mpt ? mpt->GetProperty(kRINDEX) : nullptr;
+  if (charge == 0. || path <= 0. || !rindex || rindex->GetVectorLength() < 2)
+    return;
+
+  double beta = 0.5 * (step->GetPreStepPoint()->GetBeta() + step->GetPostStepPoint()->GetBeta());
+  G4ThreeVector dir = step->GetDeltaPosition().unit();
+  double cosP = dir.z();
+  double sinP = std::sqrt(std::max(0., 1. - cosP * cosP));
+  double cosNA = std::cos(0.336);
+  double sum = 0., sumCap = 0.;
+  for (size_t i = 0; i + 1 < rindex->GetVectorLength(); i++)
+  {
+    double e = 0.5 * (rindex->Energy(i) + rindex->Energy(i + 1));
+    double n = 0.5 * ((*rindex)[i] + (*rindex)[i + 1]);
+    double cosC = 1. / (beta * n);
+    if (cosC >= 1.)
+      continue;
+    double sinC = std::sqrt(1. - cosC * cosC);
+    double w = sinC * sinC * (rindex->Energy(i + 1) - rindex->Energy(i));
+    sum += w;
+
+    // azimuths of the cone with cos(theta) > cosNA
+    double captured;
+    if (sinP * sinC < 1e-9)
+      captured = cosP * cosC > cosNA ? 1. : 0.;
+    else
+    {
+      double c = (cosNA - cosP * cosC) / (sinP * sinC);
+      captured = c <= -1. ? 1. : (c >= 1. ? 0. : std::acos(c) / M_PI);
+    }
+    sumCap += w * captured * getPDE(1239.8 * eV / e);
+  }
+  double perEnergy = 369.81 / (eV * cm) * charge * charge * path; // alpha z^2 / hbar c
+  ncer = perEnergy * sum;
+  ncercap = perEnergy * sumCap;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int B4bSteppingAction::locateCell(const G4Step *step, int &layer, int &rod)
+{
+  // middle of the step: inside the (convex) rod or fiber of the step, also
+  // when the pre-step point is on its boundary.
+  G4ThreeVector mid = 0.5 * (step->GetPreStepPoint()->GetPosition() + step->GetPostStepPoint()->GetPosition());
+  // level 1 of the history is the calorimeter, whatever is below it
+  const G4NavigationHistory *history = step->GetPreStepPoint()->GetTouchable()->GetHistory();
+  layer = rod = -1;
+  if (history->GetDepth() < 1)
+    return -1; // in the world
+  G4ThreeVector local = history->GetTransform(1).TransformPoint(mid);
+
+  double x = local.x() / mm;
+  double y = local.y() / mm;
+  if (!lattice.cell(x, y, layer, rod))
+  {
+    layer = rod = -1;
+    return -1;
+  }
+  bool cherenkov;
+  return lattice.fiber(x - lattice.rodX(rod), y - lattice.rodY(layer), cherenkov);
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -802,24 +969,17 @@ void B4bSteppingAction::fillOPInfo(const G4Step *step, bool verbose)
     }
   }
 
-  int fiberIdx = 1;
-  if (isCladS || isCladC)
-  {
-    // Core is in "Clad"
-    // if already in clad, then the first volume is the clad, aka fiber id
-    fiberIdx = 0;
-  }
-
-  int fiberNumber = preStepPoint->GetTouchableHandle()->GetCopyNumber(fiberIdx);
-  int holeNumber = preStepPoint->GetTouchableHandle()->GetCopyNumber(fiberIdx + 1);
-  int rodNumber = preStepPoint->GetTouchableHandle()->GetCopyNumber(fiberIdx + 2);
-  int layerNumber = preStepPoint->GetTouchableHandle()->GetCopyNumber(fiberIdx + 3);
+  int rodNumber = -1;
+  int layerNumber = -1;
+  int fiberNumber = locateCell(step, layerNumber, rodNumber);
+  int holeNumber = 0;
 
   double x = track->GetPosition().x() / cm;
   double y = track->GetPosition().y() / cm;
   // if (!(x > -0.0 && x < 0.4 && y > -0.0 && y < 0.4))
   // if ((!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber != 45 || layerNumber != 40) && !isGoingOutside)
-  if (!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber != 45 || layerNumber != 40)
+  if (!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber < opWindow[0] || rodNumber > opWindow[1] ||
+      layerNumber < opWindow[2] || layerNumber > opWindow[3])
   {
     // std::cout<<"Stepping Action:  optical photon outside the center"<<std::endl;
     track->SetTrackStatus(fStopAndKill);
@@ -831,6 +991,10 @@ void B4bSteppingAction::fillOPInfo(const G4Step *step, bool verbose)
   //   std::cout << "photon x" << x << "  y " << y << "  z " << track->GetPosition().z() / cm << " fiber Number " << fiberNumber << "  hole Number " << holeNumber << "  rod Number " << rodNumber << "  layer Number " << layerNumber << " isGoingOutside " << isGoingOutside << " isCoreS " << isCoreS << " isCladS " << isCladS << "isCoreC " << isCoreC << " isCladC " << isCladC << " preStep volume " << preStepPoint->GetTouchableHandle()->GetVolume()->GetName() << " postStep volume " << postStepPoint->GetTouchableHandle()->GetVolume()->GetName() << std::endl;
   // }
 
+  // photon records are only kept in the full output tier.
+  if (!hh->savePhotons())
+    return;
+
   // Check if the photon is just created.
   if (track->GetCurrentStepNumber() == 1)
   {
@@ -867,6 +1031,7 @@ void B4bSteppingAction::fillOPInfo(const G4Step *step, bool verbose)
 
     // Save initial data, exit info will be filled later
     hh->photonData.push_back(photon);
+    hh->checkPhotonBudget(trackID); // may flush the finished photons
   }
 
   // Check if the photon is leaving the detector to the world
@@ -876,8 +1041,10 @@ void B4bSteppingAction::fillOPInfo(const G4Step *step, bool verbose)
     G4ThreeVector exitMomentum = track->GetMomentum();
 
     // Find the photon in the container and update its exit information
-    for (auto &photon : hh->photonData)
+    // (the photon being tracked is the last one recorded, search backwards)
+    for (auto itr = hh->photonData.rbegin(); itr != hh->photonData.rend(); itr++)
     {
+      auto &photon = *itr;
       if (photon.trackID == trackID)
       {
         // std::cout << "Photon " << trackID << " found in container. Updating exit info. Left x " << exitPosition.x() << " y " << exitPosition.y() << " z " << exitPosition.z() << std::endl;
@@ -0,0 +1,248 @@
+#include "CaloBeamSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  const double kDeg = M_PI / 180.0;
+
+  // Gaussian pair from two flat numbers (Box-Muller)
+  void gauss2(const double *r, double &g0, double &g1)
+  {
+    double rho = std::sqrt(-2.0 * std::log(1.0 - r[0]));
+    g0 = rho * std::cos(2.0 * M_PI * r[1]);
+    g1 = rho * std::sin(2.0 * M_PI * r[1]);
+  }
+
+  // numbers of the non-empty, non-comment lines of a table file
+  std::vector<std::vector<double>> readTable(const std::string &file, size_t columns, const char *what)
+  {
+    std::ifstream in(file);
+    if (!in)
+    {
+      std::cout << "CaloBeamSampler: can not open " << what << " " << file << ". Exit.." << std::endl;
+      std::exit(0);
+    }
+    std::vector<std::vector<double>> rows;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      line = line.substr(0, line.find('#'));
+      std::istringstream is(line);
+      std::vector<double> row;
+      double v;
+      while (is >> v)
+        row.push_back(v);
+      if (row.empty())
+        continue;
+      if (row.size() != columns)
+      {
+        std::cout << "CaloBeamSampler: " << file << ": expected " << columns << " numbers in \"" << line
+                  << "\". Exit.." << std::endl;
+        std::exit(0);
+      }
+      rows.push_back(row);
+    }
+    return rows;
+  }
+
+  // cumulative, normalised probabilities of the weights
+  std::vector<double> cumulative(const std::vector<double> &w, const std::string &file)
+  {
+    std::vector<double> cdf(w.size());
+    double sum = 0;
+    bool negative = false;
+    for (size_t i = 0; i < w.size(); i++)
+    {
+      negative = negative || w[i] < 0;
+      sum += w[i];
+      cdf[i] = sum;
+    }
+    if (negative || !(sum > 0))
+    {
+      std::cout << "CaloBeamSampler: " << file << ": weights must be >= 0, not all 0. Exit.." << std::endl;
+      std::exit(0);
+    }
+    for (auto &c : cdf)
+      c /= sum;
+    cdf.back() = 1.0;
+    return cdf;
+  }
+
+  // index of the bin of u in a cumulative table
+  size_t pick(const std::vector<double> &cdf, double u)
+  {
+    size_t i = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    return std::min(i, cdf.size() - 1);
+  }
+
+  bool isSet(const std::string &file) { return !file.empty() && file != "none"; }
+}
+
+// ------------------------------------------------------------------
+CaloBeamSampler::CaloBeamSampler(const Config &config)
+    : conf(config), nDraws(7), divergenceDraw(-1), spreadDraw(-1), settingDraw(-1)
+{
+  if (isSet(conf.spectrumFile) && isSet(conf.settingsFile))
+  {
+    std::cout << "CaloBeamSampler: beamSpectrum and beamSettings can not be used together. Exit.." << std::endl;
+    std::exit(0);
+  }
+  if (isSet(conf.spectrumFile))
+    readSpectrum(conf.spectrumFile);
+  if (isSet(conf.settingsFile))
+    readSettings(conf.settingsFile);
+  else
+    settings.push_back({conf.min[3], conf.max[3] - conf.min[3], conf.angleX * kDeg, conf.angleY * kDeg});
+
+  double *d = conf.direction;
+  double norm = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  if (!(norm > 0))
+  {
+    std::cout << "CaloBeamSampler: pMomentum_* is a null vector. Exit.." << std::endl;
+    std::exit(0);
+  }
+  for (int i = 0; i < 3; i++)
+    d[i] /= norm;
+
+  // extra draws only when used: the default beam keeps the old sequence
+  if (conf.divergenceX > 0 || conf.divergenceY > 0)
+  {
+    divergenceDraw = nDraws;
+    nDraws += 2;
+  }
+  if (conf.energySpread > 0)
+  {
+    spreadDraw = nDraws;
+    nDraws += 2;
+  }
+  if (settings.size() > 1)
+  {
+    settingDraw = nDraws;
+    nDraws += 1;
+  }
+}
+
+// ------------------------------------------------------------------
+void CaloBeamSampler::readSpectrum(const std::string &file)
+{
+  // Elow Ehigh weight (GeV); Elow == Ehigh: a line
+  std::vector<double> w;
+  for (auto &row : readTable(file, 3, "beamSpectrum"))
+  {
+    binLow.push_back(row[0]);
+    binWidth.push_back(row[1] - row[0]);
+    w.push_back(row[2]);
+  }
+  if (w.empty())
+  {
+    std::cout << "CaloBeamSampler: beamSpectrum " << file << " is empty. Exit.." << std::endl;
+    std::exit(0);
+  }
+  binCdf = cumulative(w, file);
+}
+
+// ------------------------------------------------------------------
+void CaloBeamSampler::readSettings(const std::string &file)
+{
+  // weight Emin Emax (GeV) angleX angleY (degree)
+  std::vector<double> w;
+  for (auto &row : readTable(file, 5, "beamSettings"))
+  {
+    w.push_back(row[0]);
+    settings.push_back({row[1], row[2] - row[1], row[3] * kDeg, row[4] * kDeg});
+  }
+  if (w.empty())
+  {
+    std::cout << "CaloBeamSampler: beamSettings " << file << " is empty. Exit.." << std::endl;
+    std::exit(0);
+  }
+  settingCdf = cumulative(w, file);
+}
+
+// ------------------------------------------------------------------
+void CaloBeamSampler::sample(const double *r, Beam &beam) const
+{
+  beam.setting = settingDraw < 0 ? 0 : int(pick(settingCdf, r[settingDraw]));
+  const Setting &s = settings[beam.setting];
+
+  if (conf.gaussSpot)
+  {
+    double gx, gy;
+    gauss2(r + 3, gx, gy);
+    beam.x = 0.5 * (conf.min[0] + conf.max[0]) + conf.sigmaX * gx;
+    beam.y = 0.5 * (conf.min[1] + conf.max[1]) + conf.sigmaY * gy;
+  }
+  else
+  {
+    beam.x = conf.min[0] + (conf.max[0] - conf.min[0]) * r[3];
+    beam.y = conf.min[1] + (conf.max[1] - conf.min[1]) * r[4];
+  }
+  beam.z = conf.min[2] + (conf.max[2] - conf.min[2]) * r[5];
+
+  // energy: flat, or inverse of the cumulative spectrum, flat in the bin
+  if (binCdf.empty())
+  {
+    beam.energy = s.energyMin + s.energyWidth * r[6];
+  }
+  else
+  {
+    size_t i = pick(binCdf, r[6]);
+    double lo = i > 0 ? binCdf[i - 1] : 0.0;
+    double f = binCdf[i] > lo ? (r[6] - lo) / (binCdf[i] - lo) : 0.0;
+    beam.energy = binLow[i] + binWidth[i] * f;
+  }
+  if (spreadDraw >= 0)
+  {
+    double g, unused;
+    gauss2(r + spreadDraw, g, unused);
+    beam.energy = std::max(0.0, beam.energy * (1.0 + conf.energySpread * g));
+  }
+
+  // direction: turn in x-z, then in y-z
+  double ax = s.angleX, ay = s.angleY;
+  if (divergenceDraw >= 0)
+  {
+    double gx, gy;
+    gauss2(r + divergenceDraw, gx, gy);
+    ax += 1e-3 * conf.divergenceX * gx;
+    ay += 1e-3 * conf.divergenceY * gy;
+  }
+  const double *d = conf.direction;
+  double x = std::cos(ax) * d[0] + std::sin(ax) * d[2];
+  double z = -std::sin(ax) * d[0] + std::cos(ax) * d[2];
+  beam.dx = x;
+  beam.dy = std::cos(ay) * d[1] + std::sin(ay) * z;
+  beam.dz = -std::sin(ay) * d[1] + std::cos(ay) * z;
+}
+
+// ------------------------------------------------------------------
+void CaloBeamSampler::print() const
+{
+  std::cout << "CaloBeamSampler: spot " << (conf.gaussSpot ? "gauss" : "flat");
+  if (conf.gaussSpot)
+    std::cout << " sigma (" << conf.sigmaX << ", " << conf.sigmaY << ") cm";
+  std::cout << ", direction (" << conf.direction[0] << ", " << conf.direction[1] << ", " << conf.direction[2]
+            << ") divergence (" << conf.divergenceX << ", " << conf.divergenceY << ") mrad";
+  if (!binCdf.empty())
+    std::cout << ", spectrum " << conf.spectrumFile << " (" << binCdf.size() << " bins)";
+  if (conf.energySpread > 0)
+    std::cout << ", energy spread " << conf.energySpread;
+  std::cout << ", " << nDraws << " random numbers per event" << std::endl;
+  for (size_t i = 0; i < settings.size(); i++)
+  {
+    double p = settingCdf.empty() ? 1.0 : settingCdf[i] - (i > 0 ? settingCdf[i - 1] : 0.0);
+    std::cout << "  setting " << i << ": p " << p << ", E ";
+    if (binCdf.empty())
+      std::cout << settings[i].energyMin << ".." << settings[i].energyMin + settings[i].energyWidth << " GeV";
+    else
+      std::cout << "spectrum";
+    std::cout << ", angle (" << settings[i].angleX / kDeg
+              << ", " << settings[i].angleY / kDeg << ") deg" << std::endl;
+  }
+}
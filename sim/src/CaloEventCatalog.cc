@@ -0,0 +1,203 @@
+#include "CaloEventCatalog.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include <sys/types.h> // off_t: catalogs may pass 2 GB
+#include <unistd.h>    // ftruncate
+
+// ------------------------------------------------------------------
+CaloEventCatalog::CaloEventCatalog(std::string path) : fp(nullptr), header()
+{
+  std::FILE *f = std::fopen(path.c_str(), "rb");
+  if (!f)
+  {
+    std::cout << "CaloEventCatalog: can not open " << path << std::endl;
+    return;
+  }
+  if (std::fread(&header, sizeof(header), 1, f) != 1 || header.magic != CaloCatalog::kMagic ||
+      header.recordSize != sizeof(CaloCatalogRecord))
+  {
+    std::cout << "CaloEventCatalog: " << path << " is not an event catalog (version "
+              << CaloCatalog::kVersion << ")" << std::endl;
+    std::fclose(f);
+    return;
+  }
+
+  // file table after the records.
+  fseeko(f, off_t(header.fileTableOffset), SEEK_SET);
+  std::string name;
+  int c;
+  while (files.size() < header.nFiles && (c = std::fgetc(f)) != EOF)
+  {
+    if (c == 0)
+    {
+      files.push_back(name);
+      name.clear();
+    }
+    else
+    {
+      name += char(c);
+    }
+  }
+  if (files.size() != header.nFiles)
+  {
+    std::cout << "CaloEventCatalog: " << path << ": truncated file table" << std::endl;
+    std::fclose(f);
+    return;
+  }
+  fp = f;
+}
+
+// ------------------------------------------------------------------
+CaloEventCatalog::~CaloEventCatalog()
+{
+  if (fp)
+    std::fclose(fp);
+}
+
+// ------------------------------------------------------------------
+bool CaloEventCatalog::get(long index, CaloCatalogRecord &rec) const
+{
+  if (!fp || index < 0 || index >= size())
+    return false;
+  fseeko(fp, off_t(sizeof(CaloCatalogHeader) + index * sizeof(CaloCatalogRecord)), SEEK_SET);
+  return std::fread(&rec, sizeof(rec), 1, fp) == 1;
+}
+
+// ##################################################################
+CaloCatalogWriter::CaloCatalogWriter(std::string path)
+    : fp(nullptr), nEvents(0), tableOffset(sizeof(CaloCatalogHeader)), tableBytes(0)
+{
+  fp = std::fopen(path.c_str(), "w+b");
+  if (!fp)
+  {
+    std::cout << "CaloCatalogWriter: can not create " << path << ". Exit.." << std::endl;
+    std::exit(0);
+  }
+  flush();
+}
+
+// ------------------------------------------------------------------
+CaloCatalogWriter::CaloCatalogWriter(std::string path, long keepEvents, int keepFiles)
+    : fp(nullptr), nEvents(0), tableOffset(0), tableBytes(0)
+{
+  {
+    CaloEventCatalog old(path);
+    if (!old.good() || old.size() < keepEvents || old.nFiles() < keepFiles)
+    {
+      std::cout << "CaloCatalogWriter: " << path << " has less than " << keepEvents << " events. Exit.."
+                << std::endl;
+      std::exit(0);
+    }
+    for (int i = 0; i < keepFiles; i++)
+      files.push_back(old.file(i));
+  }
+  fp = std::fopen(path.c_str(), "r+b");
+  if (!fp)
+  {
+    std::cout << "CaloCatalogWriter: can not open " << path << ". Exit.." << std::endl;
+    std::exit(0);
+  }
+  nEvents = keepEvents; // later events are overwritten
+  // the new table goes after everything in the file: the old one stays
+  // valid until the header points to the new one.
+  fseeko(fp, 0, SEEK_END);
+  tableOffset = ftello(fp);
+  flush();
+}
+
+// ------------------------------------------------------------------
+CaloCatalogWriter::~CaloCatalogWriter() { close(); }
+
+// ------------------------------------------------------------------
+int CaloCatalogWriter::addFile(std::string name)
+{
+  files.push_back(name);
+  return int(files.size()) - 1;
+}
+
+// ------------------------------------------------------------------
+void CaloCatalogWriter::add(const CaloCatalogRecord &rec)
+{
+  // records go into the free space before the file table; when it is
+  // full, the table moves further out first (relocate).
+  if (recordOffset(nEvents + 1) > tableOffset)
+    relocate();
+  fseeko(fp, off_t(recordOffset(nEvents)), SEEK_SET);
+  std::fwrite(&rec, sizeof(rec), 1, fp);
+  nEvents++;
+}
+
+// ------------------------------------------------------------------
+void CaloCatalogWriter::relocate()
+{
+  // free space for as many records as there are (at least kMinFree), and
+  // never over the current table: the header points to it until flush()
+  // has written the new one.
+  long freeRecords = nEvents > kMinFree ? nEvents : kMinFree;
+  long long offset = recordOffset(nEvents + freeRecords);
+  if (offset < tableOffset + tableBytes)
+    offset = tableOffset + tableBytes;
+  tableOffset = offset;
+  flush();
+}
+
+// ------------------------------------------------------------------
+void CaloCatalogWriter::writeTable()
+{
+  // rewritten in place, the table only grows at its end: a header of an
+  // earlier flush still reads its own (shorter) table.
+  fseeko(fp, off_t(tableOffset), SEEK_SET);
+  tableBytes = 0;
+  for (auto &name : files)
+  {
+    std::fwrite(name.c_str(), 1, name.size() + 1, fp);
+    tableBytes += name.size() + 1;
+  }
+  std::fflush(fp);
+}
+
+// ------------------------------------------------------------------
+void CaloCatalogWriter::writeHeader()
+{
+  CaloCatalogHeader header = {};
+  header.magic = CaloCatalog::kMagic;
+  header.version = CaloCatalog::kVersion;
+  header.recordSize = sizeof(CaloCatalogRecord);
+  header.nFiles = files.size();
+  header.nEvents = nEvents;
+  header.fileTableOffset = tableOffset;
+  fseeko(fp, 0, SEEK_SET);
+  std::fwrite(&header, sizeof(header), 1, fp);
+  std::fflush(fp);
+}
+
+// ------------------------------------------------------------------
+void CaloCatalogWriter::flush()
+{
+  // records and table are on disk before the header refers to them
+  if (!fp)
+    return;
+  writeTable();
+  writeHeader();
+}
+
+// ------------------------------------------------------------------
+void CaloCatalogWriter::close()
+{
+  if (!fp)
+    return;
+  // table right after the records, if it does not overlap the current one
+  long long end = recordOffset(nEvents);
+  long long size = 0;
+  for (auto &name : files)
+    size += name.size() + 1;
+  if (end + size <= tableOffset)
+    tableOffset = end;
+  flush();
+  if (ftruncate(fileno(fp), off_t(tableOffset + tableBytes)) != 0)
+    std::cout << "CaloCatalogWriter: can not truncate the catalog" << std::endl;
+  std::fclose(fp);
+  fp = nullptr;
+}
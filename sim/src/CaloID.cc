@@ -1,7 +1,65 @@
 #include "CaloID.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream> // for cout
 
+// compile-time round trip of the largest value of every key field.
+namespace
+{
+   using namespace CaloIDLayout;
+   constexpr CaloKey kAllMax = pack<kType>(maxValue(kType)) | pack<kArea>(maxValue(kArea)) |
+                               pack<kIx>(maxValue(kIx)) | pack<kIy>(maxValue(kIy)) |
+                               pack<kIxx>(maxValue(kIxx)) | pack<kIyy>(maxValue(kIyy)) |
+                               pack<kZtype>(maxValue(kZtype)) | pack<kIz>(maxValue(kIz));
+   static_assert(kAllMax == (CaloKey(1) << totalBits) - 1, "CaloKey fields overlap");
+   static_assert(unpack<kIx>(kAllMax) == maxValue(kIx) && unpack<kIz>(kAllMax) == maxValue(kIz),
+                 "CaloKey round trip failed");
+   static_assert(maxValue(kIx) >= 29 && maxValue(kIy) >= 19 && maxValue(kIyy) >= 7,
+                 "CaloKey fields too narrow for the channel map");
+}
+
+// SiPM cells of the readout board: 3 rods x 4 layers, whatever the channel grid
+namespace
+{
+   const int kSipmRods = 3;
+   const int kSipmLayers = 4;
+}
+
+// full CaloX module: 90 rods x 80 layers x 200 cm, 3 x 4 rods and 2 cm per channel
+int CaloID::nIx = 30;
+int CaloID::nIy = 20;
+int CaloID::nSx = 30;
+int CaloID::nSy = 20;
+int CaloID::nRodsX = 3;
+int CaloID::nLayersY = 4;
+double CaloID::zFront = -1000.0;
+double CaloID::zLength = 2000.0;
+double CaloID::sliceZ = 20.0;
+
+// ------------------------------------------------------------------------------------
+void CaloID::setGeometry(int nRods, int nLayers, double length, int rodsPerChannel, int layersPerChannel,
+                         double dz)
+{
+   nRodsX = rodsPerChannel;
+   nLayersY = layersPerChannel;
+   nIx = (nRods + rodsPerChannel - 1) / rodsPerChannel;
+   nIy = (nLayers + layersPerChannel - 1) / layersPerChannel;
+   nSx = (nRods + kSipmRods - 1) / kSipmRods;
+   nSy = (nLayers + kSipmLayers - 1) / kSipmLayers;
+   zFront = -0.5 * length; // the calorimeter is centred at z=0
+   zLength = length;
+   sliceZ = dz;
+   if (nIx - 1 > CaloIDLayout::maxValue(CaloIDLayout::kIx) || nIy - 1 > CaloIDLayout::maxValue(CaloIDLayout::kIy))
+   {
+      std::cout << "CaloID: " << nRods << " x " << nLayers << " rods need more than the "
+                << CaloIDLayout::bits[CaloIDLayout::kIx] << "/" << CaloIDLayout::bits[CaloIDLayout::kIy]
+                << " bits of ix/iy. Exit.." << std::endl;
+      std::exit(0);
+   }
+}
+
+// ------------------------------------------------------------------------------------
 CaloID::CaloID()
 {
 }
@@ -12,16 +70,31 @@ CaloID::~CaloID()
 }
 
 CaloID::CaloID(int a_calotype, int a_fiber, int a_layer, int a_rod, double a_z, double a_t)
+{
+   init(a_calotype, a_fiber, a_layer, a_rod, a_z, a_t, a_rod / nRodsX, a_layer / nLayersY,
+        int((a_z - zFront) / sliceZ));
+}
+
+// ------------------------------------------------------------------------------------
+CaloID::CaloID(int a_calotype, int a_fiber, int a_layer, int a_rod, double a_z, double a_t, int a_ix, int a_iy,
+               int a_zslice)
+{
+   init(a_calotype, a_fiber, a_layer, a_rod, a_z, a_t, a_ix, a_iy, a_zslice);
+}
+
+// ------------------------------------------------------------------------------------
+void CaloID::init(int a_calotype, int a_fiber, int a_layer, int a_rod, double a_z, double a_t, int a_ix, int a_iy,
+                  int a_zslice)
 {
    _type = a_calotype;
    _layer = a_layer;
    _rod = a_rod;
    _fiber = a_fiber;
 
-   _nx = 3; //   number of rods per channel
-   _ny = 4; //   number of layers per channel
-   _ix = _rod / _nx;
-   _iy = _layer / _ny;
+   _nx = nRodsX;   //   number of rods per channel
+   _ny = nLayersY; //   number of layers per channel
+   _ix = a_ix;
+   _iy = a_iy;
 
    _area = findArea();
 
@@ -29,24 +102,24 @@ CaloID::CaloID(int a_calotype, int a_fiber, int a_layer, int a_rod, double a_z,
    _iyy = 0;
    if (_area == 3)
    {
-      _iyy = _layer % 4;
+      _iyy = _layer % kSipmLayers;
    }
 
    _zslice = 0;
    _tslice = 0;
 
-   z0 = -1000.0; // mm
-   dz = 20.0;    // mm
-   _zslice = int((a_z - z0) / dz);
+   z0 = zFront;  // mm
+   dz = sliceZ;  // mm
+   _zslice = a_zslice;
    if (_zslice < 0)
       _zslice = 0;
-   if (_zslice > 500)
-      _zslice = 500;
+   if (_zslice > CaloIDLayout::maxValue(CaloIDLayout::kIz))
+      _zslice = CaloIDLayout::maxValue(CaloIDLayout::kIz);
 
    t0 = 0.0;
    dt = 0.05;             // nsec
    double c = 300.0;      //  speed of light 300 mm/nsec
-   double zback = 2000.0; //  length of the calorimeter
+   double zback = zLength; //  length of the calorimeter
    // tslice=int((a_t-t0)/dt)+10;
    double zlocal = a_z - z0;
    double tlocal = a_t - t0;
@@ -54,35 +127,48 @@ CaloID::CaloID(int a_calotype, int a_fiber, int a_layer, int a_rod, double a_z,
    double tback = (zback - zlocal) / (c * 19.0 / 30.0);
    // double t=(tlocal-tof)+tback;
    double t = tlocal + tback;
-   _tslice = int(t / dt);
+   // guard the division before the int conversion (very late neutron hits).
+   double tmax = CaloIDLayout::maxValue(CaloIDLayout::kIz);
+   double ts = t / dt;
+   if (ts > tmax)
+      ts = tmax;
+   _tslice = int(ts);
    if (_tslice < 0)
       _tslice = 0;
-   if (_tslice > 511)
-      _tslice = 511;
 }
 
 // ------------------------------------------------------------------------------------
 int CaloID::findArea()
 {
-
+   // SiPM cell of the rod, relative to the edges and the centre of the
+   // module.  The widths are those of the full module (30 x 20 cells: sx
+   // 5-24/sy 2-17, centre columns 13-16 with 6 mm SiPMs in rows 0-2 and
+   // 18-19 and 3 mm ones in rows 8-11) scaled to the nSx x nSy cells, so
+   // a small module keeps its edge and centre cells.  Independent of the
+   // channel grid.
+   auto scaled = [](int n, int full, int width) { return (2 * n * width + full) / (2 * full); };
+   int ex = scaled(nSx, 30, 5), ey = scaled(nSy, 20, 2);
+   int wx = std::max(1, scaled(nSx, 30, 4)), wy = std::max(1, scaled(nSy, 20, 4));
+   int bottom = scaled(nSy, 20, 3), top = scaled(nSy, 20, 2);
+   int cx = nSx / 2 - wx / 2;
+   int cy = nSy / 2 - wy / 2;
+
+   int sx = _rod / kSipmRods;
+   int sy = _layer / kSipmLayers;
    int a = 0;
-   if (_ix > 4 && _ix < 25 && _iy > 1 && _iy < 18)
+   if (sx >= ex && sx < nSx - ex && sy >= ey && sy < nSy - ey)
    {
       a = 2; // sipm 6 mm
    }
-   if (_ix > 12 && _ix < 17)
+   if (sx >= cx && sx < cx + wx)
    {
-      if (_iy > 17 && _iy < 20)
-      {
-         a = 2; // sipm 6 mm
-      }
-      if (_iy > -1 && _iy < 3)
+      if (sy < bottom || sy >= nSy - top)
       {
          a = 2; // sipm 6 mm
       }
-      if (_iy > 7 && _iy < 12)
+      if (sy >= cy && sy < cy + wy)
       {
-         a = 3; // sipm 6 mm
+         a = 3; // sipm 3 mm
       }
    }
 
@@ -90,7 +176,7 @@ int CaloID::findArea()
 }
 
 // ------------------------------------------------------------------------------------
-CaloID::CaloID(int _key)
+CaloID::CaloID(CaloKey _key)
 {
    //  input _key is defined for only one case,  tslice or zslice...
    // dt=0.05 ;  // nsec
@@ -110,105 +196,41 @@ CaloID::CaloID(int _key)
 }
 
 // ------------------------------------------------------------------------------------
-int CaloID::getTkey()
+CaloKey CaloID::getTkey()
 {
    // return _type + _iy*10 + _ix*1000 + _it*100000 ;
    return packKey(_type, _area, _ix, _iy, _ixx, _iyy, 2, _tslice);
 }
 // ------------------------------------------------------------------------------------
-int CaloID::getZkey()
+CaloKey CaloID::getZkey()
 {
    // return _type + _iy*10 + _ix*1000 + (_iz+500)*100000 ;
    return packKey(_type, _area, _ix, _iy, _ixx, _iyy, 1, _zslice);
 }
 
 // ------------------------------------------------------------------------------------
-int CaloID::packKey(int type, int area, int ix, int iy, int ixx, int iyy, int ztype, int iz)
+CaloKey CaloID::packKey(int type, int area, int ix, int iy, int ixx, int iyy, int ztype, int iz)
 {
-   unsigned int sbits[8] = {2, 2, 5, 5, 3, 3, 2, 8}; // bits for packing (31 bits)
-
-   unsigned int k = 0;
-   unsigned int n = 0;
-   k |= type << n;
-
-   n = n + sbits[0];
-   k |= area << n;
-
-   n = n + sbits[1];
-   k |= ix << n;
-
-   n = n + sbits[2];
-   k |= iy << n;
-
-   n = n + sbits[3];
-   k |= ixx << n;
-
-   n = n + sbits[4];
-   k |= iyy << n;
-
-   n = n + sbits[5];
-   k |= ztype << n;
-
-   n = n + sbits[6];
-   k |= iz << n;
-
-   return k;
+   using namespace CaloIDLayout;
+   return pack<kType>(type) | pack<kArea>(area) | pack<kIx>(ix) | pack<kIy>(iy) |
+          pack<kIxx>(ixx) | pack<kIyy>(iyy) | pack<kZtype>(ztype) | pack<kIz>(iz);
 }
 // ------------------------------------------------------------------------------------
-int CaloID::unpackKey(unsigned int k)
+int CaloID::unpackKey(CaloKey k)
 {
-
-   unsigned int sbits[8] = {2, 2, 5, 5, 3, 3, 2, 8}; // bits for packing (31 bits)
-
-   unsigned int n = 0;
-   unsigned int mask = (1 << sbits[0]) - 1;
-   _type = k & mask;
-
-   n = n + sbits[0];
-   mask = (1 << sbits[1]) - 1;
-   _area = (k >> n) & mask;
-
-   n = n + sbits[1];
-   mask = (1 << sbits[2]) - 1;
-   _ix = (k >> n) & mask;
-
-   n = n + sbits[2];
-   mask = (1 << sbits[3]) - 1;
-   _iy = (k >> n) & mask;
-
-   n = n + sbits[3];
-   mask = (1 << sbits[4]) - 1;
-   _ixx = (k >> n) & mask;
-
-   n = n + sbits[4];
-   mask = (1 << sbits[5]) - 1;
-   _iyy = (k >> n) & mask;
-
-   n = n + sbits[5];
-   mask = (1 << sbits[6]) - 1;
-   int ztype = (k >> n) & mask;
-
-   n = n + sbits[6];
-   mask = (1 << sbits[7]) - 1;
-   int iz = (k >> n) & mask;
-
-   if (ztype == 1)
-   {
-      _zslice = iz;
-      _tslice = 0.0;
-   }
-
-   if (ztype == 2)
-   {
-      _zslice = 0.0;
-      _tslice = iz;
-   }
-
-   if (ztype == 3)
-   {
-      _zslice = 0.0;
-      _tslice = 0.0;
-   }
+   using namespace CaloIDLayout;
+   _type = unpack<kType>(k);
+   _area = unpack<kArea>(k);
+   _ix = unpack<kIx>(k);
+   _iy = unpack<kIy>(k);
+   _ixx = unpack<kIxx>(k);
+   _iyy = unpack<kIyy>(k);
+   int ztype = unpack<kZtype>(k);
+   int iz = unpack<kIz>(k);
+
+   _ztype = ztype;
+   _zslice = (ztype == 1) ? iz : 0;
+   _tslice = (ztype == 2) ? iz : 0;
 
    return 0;
 }
@@ -0,0 +1,140 @@
+#include "CaloImageWriter.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include "PhotonImage.h"
+
+#ifdef CALOX_HDF5
+#include <hdf5.h>
+static_assert(sizeof(hid_t) <= sizeof(long long), "hid_t does not fit the handles in CaloImageWriter");
+#endif
+
+namespace
+{
+#ifdef CALOX_HDF5
+  // empty dataset of rank 1 or 3, extensible along the event axis.
+  hid_t createDataset(hid_t group, const char *name, hid_t type, int rank, const hsize_t *shape,
+                      hsize_t chunkEvents, int deflate)
+  {
+    hsize_t dims[3] = {0, 0, 0};
+    hsize_t maxdims[3] = {H5S_UNLIMITED, 0, 0};
+    hsize_t chunk[3] = {chunkEvents, 0, 0};
+    for (int i = 1; i < rank; i++)
+    {
+      dims[i] = maxdims[i] = chunk[i] = shape[i];
+    }
+    hid_t space = H5Screate_simple(rank, dims, maxdims);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, rank, chunk);
+    if (deflate > 0)
+    {
+      H5Pset_shuffle(dcpl);
+      H5Pset_deflate(dcpl, deflate);
+    }
+    hid_t dset = H5Dcreate2(group, name, type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    return dset;
+  }
+
+  // append n events to dset.
+  void appendEvents(hid_t dset, hid_t type, hsize_t offset, hsize_t n, const void *buf)
+  {
+    hid_t space = H5Dget_space(dset);
+    int rank = H5Sget_simple_extent_ndims(space);
+    hsize_t dims[3];
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    H5Sclose(space);
+
+    dims[0] = offset + n;
+    H5Dset_extent(dset, dims);
+
+    hsize_t start[3] = {offset, 0, 0};
+    hsize_t count[3] = {n, dims[1], dims[2]};
+    hid_t filespace = H5Dget_space(dset);
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, nullptr, count, nullptr);
+    hid_t memspace = H5Screate_simple(rank, count, nullptr);
+    H5Dwrite(dset, type, memspace, filespace, H5P_DEFAULT, buf);
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+  }
+#endif
+}
+
+// ------------------------------------------------------------------
+CaloImageWriter::CaloImageWriter(std::string fileName, std::string groupName, int nx_, int ny_,
+                                 int chunk, int deflate)
+    : nx(nx_), ny(ny_), chunkEvents(chunk > 0 ? chunk : 1), nWritten(0),
+      file(-1), group(-1), dsetImage(-1), dsetBeamE(-1), dsetBeamID(-1)
+{
+#ifdef CALOX_HDF5
+  file = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file < 0)
+  {
+    std::cout << "CaloImageWriter: can not create " << fileName << ". Exit.." << std::endl;
+    std::exit(0);
+  }
+  group = H5Gcreate2(file, groupName.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+  hsize_t shape[3] = {0, hsize_t(ny), hsize_t(nx)};
+  dsetImage = createDataset(group, "hist2d_data", H5T_NATIVE_FLOAT, 3, shape, chunkEvents, deflate);
+  dsetBeamE = createDataset(group, "beamE", H5T_NATIVE_DOUBLE, 1, shape, chunkEvents, deflate);
+  dsetBeamID = createDataset(group, "beamID", H5T_NATIVE_INT, 1, shape, chunkEvents, deflate);
+#else
+  std::cout << "CaloImageWriter: imageOutput requested, but this build has no HDF5 support. Exit.."
+            << std::endl;
+  std::exit(0);
+#endif
+
+  std::cout << "CaloImageWriter: " << fileName << " /" << groupName << " " << ny << "x" << nx
+            << " images" << std::endl;
+}
+
+// ------------------------------------------------------------------
+CaloImageWriter::~CaloImageWriter() { close(); }
+
+// ------------------------------------------------------------------
+void CaloImageWriter::endEvent(const PhotonImage &image, double beamE, int beamID)
+{
+  pendingImages.insert(pendingImages.end(), image.data().begin(), image.data().end());
+  pendingBeamE.push_back(beamE);
+  pendingBeamID.push_back(beamID);
+
+  // one HDF5 chunk at a time
+  if (pendingBeamE.size() >= chunkEvents)
+    flush();
+}
+
+// ------------------------------------------------------------------
+void CaloImageWriter::flush()
+{
+  if (pendingBeamE.empty())
+    return;
+#ifdef CALOX_HDF5
+  hsize_t n = pendingBeamE.size();
+  appendEvents(dsetImage, H5T_NATIVE_FLOAT, nWritten, n, pendingImages.data());
+  appendEvents(dsetBeamE, H5T_NATIVE_DOUBLE, nWritten, n, pendingBeamE.data());
+  appendEvents(dsetBeamID, H5T_NATIVE_INT, nWritten, n, pendingBeamID.data());
+#endif
+  nWritten += pendingBeamE.size();
+  pendingImages.clear();
+  pendingBeamE.clear();
+  pendingBeamID.clear();
+}
+
+// ------------------------------------------------------------------
+void CaloImageWriter::close()
+{
+  if (file < 0)
+    return;
+  flush();
+#ifdef CALOX_HDF5
+  H5Dclose(dsetImage);
+  H5Dclose(dsetBeamE);
+  H5Dclose(dsetBeamID);
+  H5Gclose(group);
+  H5Fclose(file);
+#endif
+  file = -1;
+}
@@ -0,0 +1,203 @@
+#include "CaloOutput.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "TFile.h"
+
+#ifdef CALOX_RNTUPLE
+#include <ROOT/RNTupleWriteOptions.hxx>
+#endif
+
+// ------------------------------------------------------------------
+CaloOutput::CaloOutput(TFile *f, std::string n, std::string title, bool rntuple, int comp,
+                       CaloWriterThread *w, int nSlots)
+    : file(f), name(n), useRNTuple(rntuple), compression(comp), tree(nullptr),
+      ioThread(w), fillTime(0.0), nFills(0), bytesOnDisk(0)
+{
+  if (ioThread)
+  {
+    for (int i = 0; i < std::max(nSlots, 1); i++)
+      freeSlots.push_back(i);
+  }
+
+  if (!useRNTuple)
+  {
+    file->cd();
+    tree = new TTree(name.c_str(), title.c_str());
+    return;
+  }
+#ifdef CALOX_RNTUPLE
+  model = CaloRNT::RNTupleModel::Create();
+  model->SetDescription(title);
+#else
+  std::cout << "CaloOutput: outputFormat rntuple requested, but this build has no RNTuple support"
+            << " (needs ROOT >= 6.34). Exit.." << std::endl;
+  std::exit(0);
+#endif
+}
+
+// ------------------------------------------------------------------
+CaloOutput::~CaloOutput() { close(); }
+
+// ------------------------------------------------------------------
+void CaloOutput::openWriter()
+{
+#ifdef CALOX_RNTUPLE
+  // the model is frozen from here on: all columns must be booked.
+  CaloRNT::RNTupleWriteOptions options;
+  options.SetCompression(compression);
+  writer = CaloRNT::RNTupleWriter::Append(std::move(model), name, *file, options);
+  entry = writer->CreateEntry();
+  for (auto &bind : bindings)
+    bind(*entry);
+  bindings.clear();
+#endif
+}
+
+// ------------------------------------------------------------------
+void CaloOutput::write()
+{
+  if (!useRNTuple)
+  {
+    tree->Fill();
+  }
+  else
+  {
+#ifdef CALOX_RNTUPLE
+    if (!writer)
+      openWriter();
+    writer->Fill(*entry);
+#endif
+  }
+  bytesOnDisk = file->GetEND();
+}
+
+// ------------------------------------------------------------------
+void CaloOutput::writeSlot(int slot)
+{
+  for (auto &col : columns)
+    col->load(slot);
+  write();
+}
+
+// ------------------------------------------------------------------
+void CaloOutput::fill()
+{
+  auto start = std::chrono::steady_clock::now();
+  if (ioThread)
+  {
+    int slot = ioThread->acquire(this);
+    for (auto &col : columns)
+      col->stage(slot);
+    ioThread->submit(this, slot);
+  }
+  else
+  {
+    write();
+  }
+  fillTime += std::chrono::steady_clock::now() - start;
+  nFills++;
+}
+
+// ------------------------------------------------------------------
+void CaloOutput::close()
+{
+  // with a writer thread, it must have been stopped before.
+#ifdef CALOX_RNTUPLE
+  // an RNTuple without entries still gets its (empty) anchor written.
+  if (useRNTuple && model)
+    openWriter();
+  entry.reset();
+  writer.reset(); // commits the last cluster and the footer
+#endif
+}
+
+// ##################################################################
+CaloWriterThread::CaloWriterThread()
+    : writing(false), stopping(false), nSubmitted(0), nBlocked(0), maxDepth(0),
+      blockedTime(0.0), busyTime(0.0)
+{
+  thread = std::thread(&CaloWriterThread::run, this);
+}
+
+// ------------------------------------------------------------------
+CaloWriterThread::~CaloWriterThread() { stop(); }
+
+// ------------------------------------------------------------------
+int CaloWriterThread::acquire(CaloOutput *out)
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  if (out->freeSlots.empty())
+  {
+    // the I/O thread is behind: this is the backpressure on the simulation.
+    nBlocked++;
+    auto start = std::chrono::steady_clock::now();
+    slotFree.wait(lock, [out]
+                  { return !out->freeSlots.empty(); });
+    blockedTime += std::chrono::steady_clock::now() - start;
+  }
+  int slot = out->freeSlots.back();
+  out->freeSlots.pop_back();
+  return slot;
+}
+
+// ------------------------------------------------------------------
+void CaloWriterThread::submit(CaloOutput *out, int slot)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    queue.emplace_back(out, slot);
+    nSubmitted++;
+    maxDepth = std::max(maxDepth, queue.size());
+  }
+  workReady.notify_one();
+}
+
+// ------------------------------------------------------------------
+void CaloWriterThread::drain()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  slotFree.wait(lock, [this]
+                { return queue.empty() && !writing; });
+}
+
+// ------------------------------------------------------------------
+void CaloWriterThread::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  workReady.notify_one();
+  if (thread.joinable())
+    thread.join();
+}
+
+// ------------------------------------------------------------------
+void CaloWriterThread::run()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true)
+  {
+    workReady.wait(lock, [this]
+                   { return stopping || !queue.empty(); });
+    if (queue.empty())
+      return; // stopping, and everything written
+
+    std::pair<CaloOutput *, int> job = queue.front();
+    queue.pop_front();
+    writing = true;
+
+    lock.unlock();
+    auto start = std::chrono::steady_clock::now();
+    job.first->writeSlot(job.second);
+    busyTime += std::chrono::steady_clock::now() - start;
+    lock.lock();
+
+    job.first->freeSlots.push_back(job.second);
+    writing = false;
+    slotFree.notify_all();
+  }
+}
@@ -0,0 +1,139 @@
+#include "CaloPhysicsCache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4Material.hh"
+#include "G4ProductionCuts.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4VUserPhysicsList.hh"
+#include "G4Version.hh"
+
+namespace
+{
+  // FNV-1a: stable across compilers and runs, unlike std::hash.
+  std::uint64_t fnv1a(const std::string &s)
+  {
+    std::uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : s)
+    {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+}
+
+// ------------------------------------------------------------------
+CaloPhysicsCache::CaloPhysicsCache(std::string cacheDir, std::string physicsName)
+    : dir(cacheDir), physics(physicsName), retrieved(false), timed(false), buildSeconds(0),
+      tableSeconds(0)
+{
+}
+
+// ------------------------------------------------------------------
+std::string CaloPhysicsCache::signature(G4VUserPhysicsList *physicsList) const
+{
+  // everything the tables depend on: the cut table written with them is
+  // checked by Geant4 on retrieval, but a mismatch there is fatal.
+  std::ostringstream sig;
+  sig.precision(10);
+  sig << physics << " geant4 " << G4VERSION_NUMBER << " cut " << physicsList->GetDefaultCutValue();
+  for (auto region : *G4RegionStore::GetInstance())
+  {
+    G4ProductionCuts *cuts = region->GetProductionCuts();
+    sig << " region " << region->GetName();
+    if (cuts)
+      for (int i = 0; i < NumberOfG4CutIndex; i++)
+        sig << " " << cuts->GetProductionCut(i);
+  }
+  // materials of the geometry, not the whole material table: a geometry
+  // read from the GDML cache has no unused NIST materials, and the tables
+  // are only built for used ones anyway.  Sorted by name: the two fill
+  // the volume store in a different order.
+  std::map<std::string, const G4Material *> used;
+  for (auto volume : *G4LogicalVolumeStore::GetInstance())
+    if (volume->GetMaterial())
+      used[volume->GetMaterial()->GetName()] = volume->GetMaterial();
+  for (auto &entry : used)
+  {
+    const G4Material *mat = entry.second;
+    sig << " material " << mat->GetName() << " " << mat->GetDensity() << " " << mat->GetState();
+    for (size_t i = 0; i < mat->GetNumberOfElements(); i++)
+      sig << " " << mat->GetElement(i)->GetName() << " " << mat->GetFractionVector()[i];
+  }
+  return sig.str();
+}
+
+// ------------------------------------------------------------------
+void CaloPhysicsCache::prepare(G4VUserPhysicsList *physicsList)
+{
+  char key[32];
+  snprintf(key, sizeof(key), "g4%d_%016llx", G4VERSION_NUMBER,
+           (unsigned long long)fnv1a(signature(physicsList)));
+  tableDir = dir + "/" + key;
+
+  std::ifstream build(tableDir + "/build.txt");
+  if (build >> buildSeconds)
+  {
+    retrieved = true;
+    physicsList->SetPhysicsTableRetrieved(tableDir);
+    std::cout << "CaloPhysicsCache: physics tables from " << tableDir << std::endl;
+  }
+  else
+  {
+    std::cout << "CaloPhysicsCache: no physics tables in " << tableDir << ", building" << std::endl;
+  }
+  start = std::chrono::steady_clock::now();
+}
+
+// ------------------------------------------------------------------
+void CaloPhysicsCache::tablesReady()
+{
+  if (timed || tableDir.empty())
+    return; // later runs of the job do not touch the tables
+  timed = true;
+  tableSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (retrieved)
+    std::cout << "CaloPhysicsCache: physics tables retrieved in " << tableSeconds << " s, built in "
+              << buildSeconds << " s: " << (buildSeconds - tableSeconds) << " s saved" << std::endl;
+  else
+    std::cout << "CaloPhysicsCache: physics tables built in " << tableSeconds << " s" << std::endl;
+}
+
+// ------------------------------------------------------------------
+void CaloPhysicsCache::store(G4VUserPhysicsList *physicsList)
+{
+  if (retrieved || !timed)
+    return;
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  if (fs::exists(tableDir, ec))
+    return; // stored by a job that finished first
+
+  // written aside and renamed: other jobs never see half of the tables.
+  std::string tmp = tableDir + "." + std::to_string(getpid()) + ".tmp";
+  fs::create_directories(tmp, ec);
+  if (ec || !physicsList->StorePhysicsTable(tmp))
+  {
+    std::cout << "CaloPhysicsCache: can not store physics tables in " << tmp << std::endl;
+    fs::remove_all(tmp, ec);
+    return;
+  }
+  std::ofstream(tmp + "/build.txt") << tableSeconds << "\n";
+  fs::rename(tmp, tableDir, ec);
+  if (ec)
+    fs::remove_all(tmp, ec);
+  else
+    std::cout << "CaloPhysicsCache: physics tables stored in " << tableDir << std::endl;
+}
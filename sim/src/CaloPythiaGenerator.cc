@@ -0,0 +1,85 @@
+#include "CaloPythiaGenerator.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#ifdef CALOX_PYTHIA8
+#include "Pythia8/Pythia.h"
+#endif
+
+// ------------------------------------------------------------------
+CaloPythiaGenerator::CaloPythiaGenerator(std::string cardFile) : pythia(nullptr), nEvents(0), nFailed(0)
+{
+#ifdef CALOX_PYTHIA8
+  pythia = new Pythia8::Pythia();
+  if (!pythia->readFile(cardFile))
+  {
+    std::cout << "CaloPythiaGenerator: can not read card file " << cardFile << ". Exit.." << std::endl;
+    std::exit(0);
+  }
+  // seeds are set per event (generate), the card's Random:seed is not used
+  if (!pythia->init())
+  {
+    std::cout << "CaloPythiaGenerator: Pythia initialisation failed with " << cardFile << ". Exit.."
+              << std::endl;
+    std::exit(0);
+  }
+  std::cout << "CaloPythiaGenerator: Pythia " << pythia->settings.parm("Pythia:versionNumber") << " from "
+            << cardFile << std::endl;
+#else
+  (void)cardFile;
+  std::cout << "CaloPythiaGenerator: CaloXPythiaON=2 requested, but this build has no Pythia8 support"
+            << " (WITH_PYTHIA8). Exit.." << std::endl;
+  std::exit(0);
+#endif
+}
+
+// ------------------------------------------------------------------
+CaloPythiaGenerator::~CaloPythiaGenerator()
+{
+#ifdef CALOX_PYTHIA8
+  if (pythia)
+  {
+    std::cout << "CaloPythiaGenerator: " << nEvents << " events, " << nFailed << " aborted" << std::endl;
+    delete pythia;
+  }
+#endif
+}
+
+// ------------------------------------------------------------------
+bool CaloPythiaGenerator::generate(int seed, std::vector<Particle> &particles)
+{
+  particles.clear();
+#ifdef CALOX_PYTHIA8
+  // the state of the Pythia engine depends on this seed only
+  pythia->rndm.init(seed);
+  const int maxTries = 10;
+  int tries = 0;
+  while (!pythia->next())
+  {
+    nFailed++;
+    if (++tries == maxTries)
+      return false;
+  }
+  nEvents++;
+
+  const Pythia8::Event &event = pythia->event;
+  for (int i = 0; i < event.size(); i++)
+  {
+    if (event[i].isFinal())
+      particles.push_back({event[i].id(), event[i].px(), event[i].py(), event[i].pz()});
+  }
+  return true;
+#else
+  (void)seed;
+  return false;
+#endif
+}
+
+// ------------------------------------------------------------------
+void CaloPythiaGenerator::list() const
+{
+#ifdef CALOX_PYTHIA8
+  pythia->event.list();
+#endif
+}
@@ -0,0 +1,91 @@
+#include "CaloShardIndex.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+  // quoted JSON string.
+  std::string quote(const std::string &s)
+  {
+    std::string q = "\"";
+    for (char c : s)
+    {
+      if (c == '"' || c == '\\')
+        q += '\\';
+      if ((unsigned char)c < 0x20)
+        continue; // no control characters in mac file tokens
+      q += c;
+    }
+    return q + "\"";
+  }
+}
+
+// ------------------------------------------------------------------
+CaloShardIndex::CaloShardIndex(std::string fileName, const std::map<std::string, std::string> &conf)
+    : path(fileName), config(conf), runSeeds{0, 0}
+{
+}
+
+// ------------------------------------------------------------------
+void CaloShardIndex::setRunSeeds(long s0, long s1)
+{
+  runSeeds[0] = s0;
+  runSeeds[1] = s1;
+}
+
+// ------------------------------------------------------------------
+CaloShardIndex::Shard &CaloShardIndex::open(std::string shardFile)
+{
+  shards.emplace_back();
+  shards.back().file = shardFile;
+  return shards.back();
+}
+
+// ------------------------------------------------------------------
+void CaloShardIndex::close(long long bytes)
+{
+  shards.back().bytes = bytes;
+  shards.back().closed = true;
+}
+
+// ------------------------------------------------------------------
+void CaloShardIndex::restore(const Shard &shard)
+{
+  shards.push_back(shard);
+  shards.back().closed = true;
+}
+
+// ------------------------------------------------------------------
+void CaloShardIndex::write() const
+{
+  // written aside and renamed: readers never see a half-written index.
+  std::string tmp = path + ".tmp";
+  std::ofstream out(tmp);
+  out << "{\n  \"config\": {";
+  const char *sep = "\n";
+  for (auto &kv : config)
+  {
+    out << sep << "    " << quote(kv.first) << ": " << quote(kv.second);
+    sep = ",\n";
+  }
+  out << "\n  },\n";
+  out << "  \"seeds\": [" << runSeeds[0] << ", " << runSeeds[1] << "],\n";
+  out << "  \"shards\": [";
+  sep = "\n";
+  for (auto &s : shards)
+  {
+    out << sep << "    {\"file\": " << quote(s.file)
+        << ", \"firstEvent\": " << s.firstEvent << ", \"lastEvent\": " << s.lastEvent
+        << ", \"events\": " << s.events << ", \"ntupleEvents\": " << s.ntupleEvents
+        << ", \"seeds\": [" << s.seeds[0] << ", " << s.seeds[1] << "]"
+        << ", \"bytes\": " << s.bytes << ", \"closed\": " << (s.closed ? "true" : "false") << "}";
+    sep = ",\n";
+  }
+  out << "\n  ]\n}\n";
+  out.close();
+
+  if (!out || std::rename(tmp.c_str(), path.c_str()) != 0)
+    std::cout << "CaloShardIndex: can not write " << path << std::endl;
+}
@@ -0,0 +1,124 @@
+#include "CaloStreamWriter.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ------------------------------------------------------------------
+CaloStreamWriter::CaloStreamWriter(std::string socketPath)
+    : path(socketPath), listenFd(-1), clientFd(-1), nPublished(0), nDropped(0)
+{
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+  {
+    std::cout << "CaloStreamWriter: socket path too long (" << path << "). Exit.." << std::endl;
+    std::exit(0);
+  }
+  std::strcpy(addr.sun_path, path.c_str());
+
+  ::unlink(path.c_str()); // left over from a previous job
+  listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0 || ::bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(listenFd, 1) < 0)
+  {
+    std::cout << "CaloStreamWriter: can not listen on " << path << ": " << std::strerror(errno)
+              << ". Exit.." << std::endl;
+    std::exit(0);
+  }
+  ::fcntl(listenFd, F_SETFL, ::fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+  std::cout << "CaloStreamWriter: publishing events on " << path << std::endl;
+}
+
+// ------------------------------------------------------------------
+CaloStreamWriter::~CaloStreamWriter() { close(); }
+
+// ------------------------------------------------------------------
+void CaloStreamWriter::acceptConsumer()
+{
+  int fd = ::accept(listenFd, nullptr, nullptr);
+  if (fd < 0)
+    return; // nobody waiting
+  // the accepted socket blocks, so a slow consumer throttles the simulation.
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+  clientFd = fd;
+  std::cout << "CaloStreamWriter: consumer connected" << std::endl;
+}
+
+// ------------------------------------------------------------------
+bool CaloStreamWriter::sendAll(const void *buf, size_t n)
+{
+  const char *p = (const char *)buf;
+  while (n > 0)
+  {
+    ssize_t k = ::send(clientFd, p, n, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+// ------------------------------------------------------------------
+void CaloStreamWriter::publish(CaloStreamHeader header,
+                               const std::vector<CaloStreamChannel> &ss,
+                               const std::vector<CaloStreamChannel> &cc,
+                               const std::vector<float> *image, int nx, int ny)
+{
+  if (clientFd < 0)
+    acceptConsumer();
+  if (clientFd < 0)
+  {
+    nDropped++;
+    return;
+  }
+
+  size_t imageSize = image ? size_t(nx) * ny : 0;
+  header.magic = CaloStream::kMagic;
+  header.version = CaloStream::kVersion;
+  header.headerSize = sizeof(CaloStreamHeader);
+  header.nSS = ss.size();
+  header.nCC = cc.size();
+  header.imageNx = image ? nx : 0;
+  header.imageNy = image ? ny : 0;
+  header.payloadSize = (ss.size() + cc.size()) * sizeof(CaloStreamChannel) + imageSize * sizeof(float);
+
+  bool ok = sendAll(&header, sizeof(header)) &&
+            sendAll(ss.data(), ss.size() * sizeof(CaloStreamChannel)) &&
+            sendAll(cc.data(), cc.size() * sizeof(CaloStreamChannel)) &&
+            (imageSize == 0 || sendAll(image->data(), imageSize * sizeof(float)));
+  if (ok)
+  {
+    nPublished++;
+    return;
+  }
+
+  // consumer went away: wait for the next one.
+  std::cout << "CaloStreamWriter: consumer disconnected" << std::endl;
+  ::close(clientFd);
+  clientFd = -1;
+  nDropped++;
+}
+
+// ------------------------------------------------------------------
+void CaloStreamWriter::close()
+{
+  if (clientFd >= 0)
+    ::close(clientFd); // end of stream for the consumer
+  if (listenFd >= 0)
+  {
+    ::close(listenFd);
+    ::unlink(path.c_str());
+  }
+  clientFd = -1;
+  listenFd = -1;
+}
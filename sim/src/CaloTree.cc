@@ -1,5 +1,6 @@
 #include "CaloTree.h"
 
+#include <algorithm> // for std::min
 #include <chrono>  // from std::
 #include <cstdlib> // for rand() on archer.
 #include <ctime>
@@ -19,19 +20,91 @@
 #include "TH2D.h"
 #include "TPad.h"
 #include "TPaveText.h"
+#include "TROOT.h"
 #include "TText.h"
 #include "TTree.h"
 #include <numeric>
 
 #include "CaloHit.h"
 #include "CaloID.h"
+#include "CaloImageWriter.h"
+#include "CaloEventCatalog.h"
+#include "CaloOutput.h"
+#include "CaloShardIndex.h"
+#include "CaloStreamWriter.h"
+#include "PhotonImage.h"
 #include "PhotonInfo.h"
+#include "Randomize.hh"
 
 using namespace std;
 
+namespace
+{
+  // clear a vector, and free its buffer if it grew beyond maxBytes.
+  template <class T>
+  void resetVector(vector<T> &v, size_t maxBytes)
+  {
+    if (v.capacity() * sizeof(T) > maxBytes)
+      vector<T>().swap(v);
+    else
+      v.clear();
+  }
+
+  // book a double column, or its float copy in the compact schema.
+  void branchColumn(CaloOutput *t, const char *name, vector<double> &d, vector<float> &f, bool useFloat, int basket)
+  {
+    if (useFloat)
+      t->book(name, &f, basket);
+    else
+      t->book(name, &d, basket);
+  }
+
+  // fill the column booked by branchColumn.
+  inline void pushColumn(vector<double> &d, vector<float> &f, bool useFloat, double val)
+  {
+    if (useFloat)
+      f.push_back(float(val));
+    else
+      d.push_back(val);
+  }
+
+  // SplitMix64 finalizer: well-mixed 64 bits from consecutive inputs.
+  std::uint64_t splitmix64(std::uint64_t x)
+  {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  // fiber number + 1 in 4 bits, 0 for photons not in a fiber (-99).
+  inline unsigned int fiberBits(int fiber)
+  {
+    return (fiber < 0 || fiber > 14) ? 0u : unsigned(fiber + 1);
+  }
+
+  unsigned int packOPFlags(const PhotonInfo &photon)
+  {
+    unsigned int flags = 0;
+    flags |= unsigned(photon.isCerenkov) << OPFlags::kCerenkov;
+    flags |= unsigned(photon.isScintillation) << OPFlags::kScintillation;
+    flags |= unsigned(photon.isCoreC) << OPFlags::kCoreC;
+    flags |= unsigned(photon.isCoreS) << OPFlags::kCoreS;
+    flags |= unsigned(photon.isCladC) << OPFlags::kCladC;
+    flags |= unsigned(photon.isCladS) << OPFlags::kCladS;
+    flags |= fiberBits(photon.productionFiber) << OPFlags::kProductionFiberShift;
+    flags |= fiberBits(photon.exitFiber) << OPFlags::kFinalFiberShift;
+    return flags;
+  }
+}
+
 // ------------------------------------------------------------------
 
 CaloTree::CaloTree(string macFileName, int argc, char **argv)
+    : photonData(&eventArena), truthDeposits(&eventArena),
+      rtHits(&eventArena), rzHits(&eventArena), rzEdep(&eventArena),
+      stHits(&eventArena), szHits(&eventArena), szEdep(&eventArena),
+      ctHits(&eventArena), czHits(&eventArena), czEdep(&eventArena)
 {
   cout << "initializing CaloTree...   macFileName:" << macFileName << endl;
 
@@ -61,17 +134,103 @@ CaloTree::CaloTree(string macFileName, int argc, char **argv)
       getParamS("runSeq") + "_" + getParamS("runConfig") + "_" +
       getParamS("numberOfEvents") + "evt_" + getParamS("gun_particle") + "_" +
       getParamS("gun_energy_min") + "_" + getParamS("gun_energy_max");
-  string outRootName = getParamS("rootPre") + "_" + outname + ".root";
 
   eventCounts = 0;
   eventCountsALL = 0;
 
+  //  output tier: which columns are booked and which vectors are filled.
+  string tier = getParamS("outputTier");
+  if (tier == "summary")
+    outputTier = kTierSummary;
+  else if (tier == "channels")
+    outputTier = kTierChannels;
+  else if (tier == "truth")
+    outputTier = kTierTruth;
+  else if (tier == "full")
+    outputTier = kTierFull;
+  else
+  {
+    std::cout << "CaloTree: unknown outputTier (" << tier
+              << "), use summary, channels, truth or full. Exit.." << std::endl;
+    std::exit(0);
+  }
+  if (getParamS("miniNtuple").compare(0, 4, "true") == 0)
+    outputTier = min(outputTier, int(kTierChannels));
+
+  //  ML-ready photon-exit images, binned during the run, written to HDF5
+  //  and/or published with the event on the stream socket.
+  imageWriter = nullptr;
+  streamWriter = nullptr;
+  photonImage = nullptr;
+  bool wantImage = getParamS("imageOutput").compare(0, 4, "true") == 0;
+  if (getParamS("streamOutput").compare(0, 4, "true") == 0)
+  {
+    streamWriter = new CaloStreamWriter(getParamS("streamSocket"));
+    if (getParamS("streamImage").compare(0, 4, "true") == 0)
+      wantImage = true;
+  }
+  if (wantImage)
+  {
+    photonImage = new PhotonImage(getParamI("imageNx"), getParamF("imageXmin"), getParamF("imageDx"),
+                                  getParamI("imageNy"), getParamF("imageYmin"), getParamF("imageDy"),
+                                  getParamF("imageZmin"), getParamS("imageSelect"));
+  }
+  if (getParamS("imageOutput").compare(0, 4, "true") == 0)
+  {
+    string imageName = getParamS("rootPre") + "_" + outname + ".h5";
+    string groupName = getParamS("gun_particle") + "_E" + getParamS("gun_energy_min") + "-" +
+                       getParamS("gun_energy_max") + "_" + getParamS("numberOfEvents");
+    imageWriter = new CaloImageWriter(imageName, groupName, getParamI("imageNx"), getParamI("imageNy"),
+                                      getParamI("imageChunkEvents"), getParamI("imageDeflate"));
+  }
+  recordPhotons = outputTier >= kTierFull || photonImage;
+
   saveTruthHits = false;
-  if (getParamS("saveTruthHits").compare(0, 4, "true") == 0)
+  if (getParamS("saveTruthHits").compare(0, 4, "true") == 0 && outputTier >= kTierTruth)
     saveTruthHits = true;
 
-  //  ========  root histogram, ntuple file ===========
-  fout = new TFile(outRootName.c_str(), "recreate");
+  compactTruthHits = false;
+  if (getParamS("truthHitMode").compare(0, 7, "compact") == 0)
+    compactTruthHits = true;
+  truthCompactDz = getParamF("truthCompactDz");
+  truthCompactDt = getParamF("truthCompactDt");
+  if (compactTruthHits && (getParamI("caloLayers") > (1 << TruthKey::kLayerBits) ||
+                           getParamI("caloRods") > (1 << TruthKey::kRodBits)))
+  {
+    cout << "CaloTree: truthHitMode compact: " << getParamI("caloRods") << " x " << getParamI("caloLayers")
+         << " rods need more than the " << TruthKey::kRodBits << "/" << TruthKey::kLayerBits
+         << " bits of rod/layer in the truth key. Exit.." << endl;
+    std::exit(0);
+  }
+
+  //  per-event memory: arena block kept between events, and the largest
+  //  ntuple vector kept without being freed.
+  eventArena.setRetainedSize(size_t(getParamI("eventArenaMB")) << 20);
+  vectorMaxBytes = size_t(getParamI("eventVectorMaxMB")) << 20;
+  photonBudgetBytes = size_t(getParamI("photonBudgetMB")) << 20;
+
+  //  output schema: float columns and packed OP_flags in the compact one.
+  compactSchema = false;
+  if (getParamS("outputSchema").compare(0, 7, "compact") == 0)
+    compactSchema = true;
+  basketBytes = getParamI("outputBasketKB") * 1024;
+
+  //  ttree or rntuple; with outputThreads > 0 baskets/pages are compressed in parallel.
+  useRNTuple = false;
+  if (getParamS("outputFormat").compare(0, 7, "rntuple") == 0)
+    useRNTuple = true;
+  if (getParamI("outputThreads") > 0)
+    ROOT::EnableImplicitMT(getParamI("outputThreads"));
+
+  //  asynchronous output: Fill and compression on an I/O thread, fed with
+  //  up to outputQueueDepth staged events per tree.
+  ioThread = nullptr;
+  queueDepth = getParamI("outputQueueDepth");
+  if (getParamS("outputAsync").compare(0, 4, "true") == 0)
+  {
+    ROOT::EnableThreadSafety();
+    ioThread = new CaloWriterThread();
+  }
 
   createNtuple = false;
   if (getParamS("createNtuple").compare(0, 4, "true") == 0)
@@ -160,124 +319,320 @@ CaloTree::CaloTree(string macFileName, int argc, char **argv)
   histo1D["cerWLcapturedELEC"] = new TH1D(
       "cerWLcapturedELEC", "wave length capturedElec", 200, 0.0, 1000.0);
   // ==========================
-  tree = new TTree("tree", "CaloX Tree");
+  //  histograms are written to (and reset for) every output shard.
+  for (auto &h : histo1D)
+    h.second->SetDirectory(nullptr);
+  for (auto &h : histo2D)
+    h.second->SetDirectory(nullptr);
+
+  //  random seeds: per event from (runNumber, runSeq, event number), or
+  //  one engine stream for the whole job (the exampleB4b seeds).
+  string seeding = getParamS("eventSeeding");
+  if (seeding != "event" && seeding != "job")
+  {
+    std::cout << "CaloTree: unknown eventSeeding (" << seeding << "), use event or job. Exit.." << std::endl;
+    std::exit(0);
+  }
+  perEventSeeds = seeding == "event";
+  eventSeeds[0] = 0;
+  eventSeeds[1] = 0;
+
+  //  -replayEvent N: this event only, into its own file and in the ntuple.
+  replayEvent = getParamI("replayEvent");
+  if (replayEvent > 0 && !perEventSeeds)
+  {
+    std::cout << "CaloTree: replayEvent needs eventSeeding event. Exit.." << std::endl;
+    std::exit(0);
+  }
+
+  //  output shards: a new file every outputShardEvents events or
+  //  outputShardMB MB (0: no limit), listed in the shard index.
+  outBaseName = getParamS("rootPre") + "_" + outname;
+  shardMaxEvents = getParamI("outputShardEvents");
+  shardMaxBytes = (long long)(getParamI("outputShardMB")) << 20;
+  if (replayEvent > 0)
+  {
+    outBaseName += "_replay" + std::to_string(replayEvent);
+    shardMaxEvents = 0;
+    shardMaxBytes = 0;
+    eventCounts = replayEvent - 1;
+    eventCountsALL = replayEvent - 1;
+  }
+  fillSeconds = 0.0;
+  fillCount = 0;
+  fout = nullptr;
+  tree = nullptr;
+  spillTree = nullptr;
+  shardIndex = new CaloShardIndex(outBaseName + "_index.json", mcParams);
+
+  //  checkpoints: every checkpointEvents events the shard is closed and the
+  //  event counters and random engine are saved; -resume true continues
+  //  from the last one into a new shard.
+  checkpointEvents = replayEvent > 0 ? 0 : getParamI("checkpointEvents");
+  checkpointName = outBaseName + "_checkpoint";
+  resumed = replayEvent == 0 && getParamS("resume").compare(0, 4, "true") == 0;
+  py8Event = -1;
+  long catalogEvents = 0;
+  int catalogFiles = 0;
+  if (resumed)
+    readCheckpoint(catalogEvents, catalogFiles);
+
+  //  event catalog: global event index -> (file, tree entry, seeds, beam)
+  catalog = nullptr;
+  catalogFile = 0;
+  if (getParamS("eventCatalog").compare(0, 4, "true") == 0)
+  {
+    if (resumed)
+      catalog = new CaloCatalogWriter(outBaseName + "_catalog.cxc", catalogEvents, catalogFiles);
+    else
+      catalog = new CaloCatalogWriter(outBaseName + "_catalog.cxc");
+  }
+  openShard();
+}
+
+CaloTree::~CaloTree() { std::cout << "deleting CaloTree..." << std::endl; }
+
+// ########################################################################
+void CaloTree::openShard()
+{
+  string outRootName = outBaseName + ".root";
+  if (shardMaxEvents > 0 || shardMaxBytes > 0 || checkpointEvents > 0 || resumed)
+  {
+    char seq[16];
+    snprintf(seq, sizeof(seq), "_shard%03d", shardIndex->size());
+    outRootName = outBaseName + seq + ".root";
+  }
+  shardIndex->open(outRootName);
+  shardIndex->write();
+  if (catalog)
+  {
+    // relative to the catalog, which is in the directory of outBaseName
+    size_t slash = outBaseName.rfind('/');
+    catalogFile = catalog->addFile(slash == string::npos ? outRootName : outRootName.substr(slash + 1));
+  }
+
+  //  ========  root histogram, ntuple file ===========
+  fout = new TFile(outRootName.c_str(), "recreate");
+  fout->SetCompressionSettings(getParamI("outputCompression"));
+
+  tree = new CaloOutput(fout, "tree", "CaloX Tree", useRNTuple, getParamI("outputCompression"),
+                        ioThread, queueDepth);
 
   // set event counter.
 
-  tree->Branch("run", &m_run);
-  tree->Branch("event", &m_event);
-
-  tree->Branch("beamMinE", &m_beamMinE);
-  tree->Branch("beamMaxE", &m_beamMaxE);
-  tree->Branch("gridSizeX", &m_gridSizeX);
-  tree->Branch("gridSizeY", &m_gridSizeY);
-  tree->Branch("gridSizeT", &m_gridSizeT);
-
-  tree->Branch("calibSen", &m_calibSen);
-  tree->Branch("calibSph", &m_calibSph);
-  tree->Branch("calibCen", &m_calibCen);
-  tree->Branch("calibCph", &m_calibCph);
-
-  tree->Branch("beamX", &m_beamX);
-  tree->Branch("beamY", &m_beamY);
-  tree->Branch("beamZ", &m_beamZ);
-  tree->Branch("beamE", &m_beamE);
-  tree->Branch("beamID", &m_beamID);
-  tree->Branch("beamType", &m_beamType);
-
-  tree->Branch("ntruthhits", &m_nhitstruth);
-  tree->Branch("truthhit_pid", &m_pidtruth);
-  tree->Branch("truthhit_trackid", &m_trackidtruth);
-  tree->Branch("truthhit_calotype", &m_calotypetruth);
-  tree->Branch("truthhit_x", &m_xtruth);
-  tree->Branch("truthhit_y", &m_ytruth);
-  tree->Branch("truthhit_z", &m_ztruth);
-  tree->Branch("truthhit_steplength", &m_steplengthtruth);
-  tree->Branch("truthhit_globaltime", &m_globaltimetruth);
-  tree->Branch("truthhit_localtime", &m_localtimetruth);
-  tree->Branch("truthhit_edep", &m_edeptruth);
-  tree->Branch("truthhit_edepNonIon", &m_edepNonIontruth);
-  tree->Branch("truthhit_edepInv", &m_edepInvtruth);
-  tree->Branch("truthhit_edepbirk", &m_edepbirktruth);
-  tree->Branch("truthhit_ncer", &m_ncertruth);
-  tree->Branch("truthhit_ncercap", &m_ncercaptruth);
-  tree->Branch("truthhit_layerNumber", &m_layerNumber);
-  tree->Branch("truthhit_rodNumber", &m_rodNumber);
-  tree->Branch("truthhit_fiberNumber", &m_fiberNumber);
-
-  tree->Branch("eCalotruth", &m_eCalotruth);
-  tree->Branch("eWorldtruth", &m_eWorldtruth);
-  tree->Branch("eLeaktruth", &m_eLeaktruth);
-  tree->Branch("eInvisible", &m_eInvisible);
-  tree->Branch("eRodtruth", &m_eRodtruth);
-  tree->Branch("eCentruth", &m_eCentruth);
-  tree->Branch("eScintruth", &m_eScintruth);
-
-  tree->Branch("nhits3dSS", &m_nhits3dSS);
-  tree->Branch("id3dSS", &m_id3dSS);
-  tree->Branch("type3dSS", &m_type3dSS);
-  tree->Branch("area3dSS", &m_area3dSS);
-  tree->Branch("ix3dSS", &m_ix3dSS);
-  tree->Branch("iy3dSS", &m_iy3dSS);
-  tree->Branch("ixx3dSS", &m_ixx3dSS);
-  tree->Branch("iyy3dSS", &m_iyy3dSS);
-  tree->Branch("zslice3dSS", &m_zslice3dSS);
-  tree->Branch("tslice3dSS", &m_tslice3dSS);
-  tree->Branch("ph3dSS", &m_ph3dSS);
-  tree->Branch("sum3dSS", &m_sum3dSS);
-
-  tree->Branch("nhits3dCC", &m_nhits3dCC);
-  tree->Branch("id3dCC", &m_id3dCC);
-  tree->Branch("type3dCC", &m_type3dCC);
-  tree->Branch("area3dCC", &m_area3dCC);
-  tree->Branch("ix3dCC", &m_ix3dCC);
-  tree->Branch("iy3dCC", &m_iy3dCC);
-  tree->Branch("ixx3dCC", &m_ixx3dCC);
-  tree->Branch("iyy3dCC", &m_iyy3dCC);
-  tree->Branch("zslice3dCC", &m_zslice3dCC);
-  tree->Branch("tslice3dCC", &m_tslice3dCC);
-  tree->Branch("ph3dCC", &m_ph3dCC);
-  tree->Branch("sum3dCC", &m_sum3dCC);
-
-  tree->Branch("nOPs", &mP_nOPs);
-  tree->Branch("OP_trackid", &mP_trackid);
-  tree->Branch("OP_pos_produced_x", &mP_pos_produced_x);
-  tree->Branch("OP_pos_produced_y", &mP_pos_produced_y);
-  tree->Branch("OP_pos_produced_z", &mP_pos_produced_z);
-  tree->Branch("OP_mom_produced_x", &mP_mom_produced_x);
-  tree->Branch("OP_mom_produced_y", &mP_mom_produced_y);
-  tree->Branch("OP_mom_produced_z", &mP_mom_produced_z);
-  tree->Branch("OP_pos_final_x", &mP_pos_final_x);
-  tree->Branch("OP_pos_final_y", &mP_pos_final_y);
-  tree->Branch("OP_pos_final_z", &mP_pos_final_z);
-  tree->Branch("OP_mom_final_x", &mP_mom_final_x);
-  tree->Branch("OP_mom_final_y", &mP_mom_final_y);
-  tree->Branch("OP_mom_final_z", &mP_mom_final_z);
-  tree->Branch("OP_time_produced", &mP_time_produced);
-  tree->Branch("OP_time_final", &mP_time_final);
-  tree->Branch("OP_isCerenkov", &mP_isCerenkov);
-  tree->Branch("OP_isScintillation", &mP_isScintillation);
-  tree->Branch("OP_productionFiber", &mP_productionFiber);
-  tree->Branch("OP_finalFiber", &mP_finalFiber);
-  tree->Branch("OP_isCoreC", &mP_isCoreC);
-  tree->Branch("OP_isCoreS", &mP_isCoreS);
-  tree->Branch("OP_isCladC", &mP_isCladC);
-  tree->Branch("OP_isCladS", &mP_isCladS);
-  tree->Branch("OP_pol_x", &mP_pol_x);
-  tree->Branch("OP_pol_y", &mP_pol_y);
-  tree->Branch("OP_pol_z", &mP_pol_z);
+  tree->book("run", &m_run);
+  tree->book("event", &m_event);
+  tree->book("seed0", &m_seed0);
+  tree->book("seed1", &m_seed1);
+
+  tree->book("beamMinE", &m_beamMinE);
+  tree->book("beamMaxE", &m_beamMaxE);
+  tree->book("gridSizeX", &m_gridSizeX);
+  tree->book("gridSizeY", &m_gridSizeY);
+  tree->book("gridSizeT", &m_gridSizeT);
+
+  tree->book("calibSen", &m_calibSen);
+  tree->book("calibSph", &m_calibSph);
+  tree->book("calibCen", &m_calibCen);
+  tree->book("calibCph", &m_calibCph);
+
+  tree->book("beamX", &m_beamX);
+  tree->book("beamY", &m_beamY);
+  tree->book("beamZ", &m_beamZ);
+  tree->book("beamE", &m_beamE);
+  tree->book("beamID", &m_beamID);
+  tree->book("beamDx", &m_beamDx);
+  tree->book("beamDy", &m_beamDy);
+  tree->book("beamDz", &m_beamDz);
+  tree->book("beamType", &m_beamType);
+
+  if (outputTier >= kTierTruth)
+  {
+    tree->book("ntruthhits", &m_nhitstruth);
+    tree->book("truthhit_pid", &m_pidtruth, basketBytes);
+    tree->book("truthhit_trackid", &m_trackidtruth, basketBytes);
+    tree->book("truthhit_calotype", &m_calotypetruth, basketBytes);
+    branchColumn(tree, "truthhit_x", m_xtruth, m_xtruthF, compactSchema, basketBytes);
+    branchColumn(tree, "truthhit_y", m_ytruth, m_ytruthF, compactSchema, basketBytes);
+    branchColumn(tree, "truthhit_z", m_ztruth, m_ztruthF, compactSchema, basketBytes);
+    branchColumn(tree, "truthhit_steplength", m_steplengthtruth, m_steplengthtruthF, compactSchema, basketBytes);
+    branchColumn(tree, "truthhit_globaltime", m_globaltimetruth, m_globaltimetruthF, compactSchema, basketBytes);
+    branchColumn(tree, "truthhit_localtime", m_localtimetruth, m_localtimetruthF, compactSchema, basketBytes);
+    tree->book("truthhit_edep", &m_edeptruth, basketBytes);
+    tree->book("truthhit_edepNonIon", &m_edepNonIontruth, basketBytes);
+    tree->book("truthhit_edepInv", &m_edepInvtruth, basketBytes);
+    tree->book("truthhit_edepbirk", &m_edepbirktruth, basketBytes);
+    tree->book("truthhit_ncer", &m_ncertruth, basketBytes);
+    tree->book("truthhit_ncercap", &m_ncercaptruth, basketBytes);
+    tree->book("truthhit_layerNumber", &m_layerNumber, basketBytes);
+    tree->book("truthhit_rodNumber", &m_rodNumber, basketBytes);
+    tree->book("truthhit_fiberNumber", &m_fiberNumber, basketBytes);
+    if (compactTruthHits)
+      tree->book("truthhit_nsteps", &m_nstepstruth, basketBytes);
+  }
+
+  tree->book("eCalotruth", &m_eCalotruth);
+  tree->book("eWorldtruth", &m_eWorldtruth);
+  tree->book("eLeaktruth", &m_eLeaktruth);
+  tree->book("eInvisible", &m_eInvisible);
+  tree->book("eRodtruth", &m_eRodtruth);
+  tree->book("eCentruth", &m_eCentruth);
+  tree->book("eScintruth", &m_eScintruth);
+
+  tree->book("nhits3dSS", &m_nhits3dSS);
+  if (outputTier >= kTierChannels)
+  {
+    tree->book("id3dSS", &m_id3dSS);
+    tree->book("type3dSS", &m_type3dSS);
+    tree->book("area3dSS", &m_area3dSS);
+    tree->book("ix3dSS", &m_ix3dSS);
+    tree->book("iy3dSS", &m_iy3dSS);
+    tree->book("ixx3dSS", &m_ixx3dSS);
+    tree->book("iyy3dSS", &m_iyy3dSS);
+    tree->book("zslice3dSS", &m_zslice3dSS);
+    tree->book("tslice3dSS", &m_tslice3dSS);
+    tree->book("ph3dSS", &m_ph3dSS);
+  }
+  tree->book("sum3dSS", &m_sum3dSS);
+
+  tree->book("nhits3dCC", &m_nhits3dCC);
+  if (outputTier >= kTierChannels)
+  {
+    tree->book("id3dCC", &m_id3dCC);
+    tree->book("type3dCC", &m_type3dCC);
+    tree->book("area3dCC", &m_area3dCC);
+    tree->book("ix3dCC", &m_ix3dCC);
+    tree->book("iy3dCC", &m_iy3dCC);
+    tree->book("ixx3dCC", &m_ixx3dCC);
+    tree->book("iyy3dCC", &m_iyy3dCC);
+    tree->book("zslice3dCC", &m_zslice3dCC);
+    tree->book("tslice3dCC", &m_tslice3dCC);
+    tree->book("ph3dCC", &m_ph3dCC);
+  }
+  tree->book("sum3dCC", &m_sum3dCC);
+
+  if (outputTier >= kTierFull)
+  {
+    tree->book("nOPs", &mP_nOPs);
+    bookPhotonBranches(tree);
+    tree->book("nOPspilled", &mP_nOPspilled);
+    tree->book("nOPchunks", &mP_nOPchunks);
+  }
+
+  //  photons spilled in the middle of an event share the OP_* buffers with
+  //  the main tree; only one of the two trees is filled at a time.
+  spillTree = nullptr;
+  if (photonBudgetBytes > 0 && outputTier >= kTierFull)
+  {
+    spillTree = new CaloOutput(fout, "opspill", "CaloX optical photons spilled during the event",
+                               useRNTuple, getParamI("outputCompression"), ioThread, queueDepth);
+    spillTree->book("run", &m_run);
+    spillTree->book("event", &m_event);
+    spillTree->book("chunk", &mP_chunk);
+    spillTree->book("nOPs", &mP_nOPs);
+    bookPhotonBranches(spillTree);
+  }
 }
 
 // ########################################################################
-CaloTree::~CaloTree() { std::cout << "deleting CaloTree..." << std::endl; }
+void CaloTree::closeShard()
+{
+  // records of this shard still queued on the I/O thread go first.
+  if (ioThread)
+    ioThread->drain();
+  tree->close();
+  if (spillTree)
+    spillTree->close();
+  fillSeconds += tree->fillSeconds();
+  fillCount += tree->fillCount();
+
+  fout->cd();
+  for (auto &h : histo1D)
+  {
+    h.second->Write();
+    h.second->Reset();
+  }
+  for (auto &h : histo2D)
+  {
+    h.second->Write();
+    h.second->Reset();
+  }
+  fout->Write();
+  long long bytes = fout->GetSize();
+  fout->Close(); // deletes the TTrees
+  delete fout;
+  delete tree;
+  delete spillTree;
+  fout = nullptr;
+  tree = nullptr;
+  spillTree = nullptr;
+
+  shardIndex->close(bytes);
+  shardIndex->write();
+  if (catalog)
+    catalog->flush();
+  std::cout << "CaloTree: closed " << shardIndex->current().file << " (events "
+            << shardIndex->current().firstEvent << "-" << shardIndex->current().lastEvent << ", "
+            << (bytes >> 20) << " MB)" << std::endl;
+}
+
+// ########################################################################
+void CaloTree::bookPhotonBranches(CaloOutput *t)
+{
+  // OP_* branches, shared by the main tree and spillTree.
+  t->book("OP_trackid", &mP_trackid, basketBytes);
+  branchColumn(t, "OP_pos_produced_x", mP_pos_produced_x, mF_pos_produced_x, compactSchema, basketBytes);
+  branchColumn(t, "OP_pos_produced_y", mP_pos_produced_y, mF_pos_produced_y, compactSchema, basketBytes);
+  branchColumn(t, "OP_pos_produced_z", mP_pos_produced_z, mF_pos_produced_z, compactSchema, basketBytes);
+  branchColumn(t, "OP_mom_produced_x", mP_mom_produced_x, mF_mom_produced_x, compactSchema, basketBytes);
+  branchColumn(t, "OP_mom_produced_y", mP_mom_produced_y, mF_mom_produced_y, compactSchema, basketBytes);
+  branchColumn(t, "OP_mom_produced_z", mP_mom_produced_z, mF_mom_produced_z, compactSchema, basketBytes);
+  branchColumn(t, "OP_pos_final_x", mP_pos_final_x, mF_pos_final_x, compactSchema, basketBytes);
+  branchColumn(t, "OP_pos_final_y", mP_pos_final_y, mF_pos_final_y, compactSchema, basketBytes);
+  branchColumn(t, "OP_pos_final_z", mP_pos_final_z, mF_pos_final_z, compactSchema, basketBytes);
+  branchColumn(t, "OP_mom_final_x", mP_mom_final_x, mF_mom_final_x, compactSchema, basketBytes);
+  branchColumn(t, "OP_mom_final_y", mP_mom_final_y, mF_mom_final_y, compactSchema, basketBytes);
+  branchColumn(t, "OP_mom_final_z", mP_mom_final_z, mF_mom_final_z, compactSchema, basketBytes);
+  branchColumn(t, "OP_time_produced", mP_time_produced, mF_time_produced, compactSchema, basketBytes);
+  branchColumn(t, "OP_time_final", mP_time_final, mF_time_final, compactSchema, basketBytes);
+  if (compactSchema)
+  {
+    t->book("OP_flags", &mP_flags, basketBytes);
+  }
+  else
+  {
+    t->book("OP_isCerenkov", &mP_isCerenkov, basketBytes);
+    t->book("OP_isScintillation", &mP_isScintillation, basketBytes);
+    t->book("OP_productionFiber", &mP_productionFiber, basketBytes);
+    t->book("OP_finalFiber", &mP_finalFiber, basketBytes);
+    t->book("OP_isCoreC", &mP_isCoreC, basketBytes);
+    t->book("OP_isCoreS", &mP_isCoreS, basketBytes);
+    t->book("OP_isCladC", &mP_isCladC, basketBytes);
+    t->book("OP_isCladS", &mP_isCladS, basketBytes);
+  }
+  branchColumn(t, "OP_pol_x", mP_pol_x, mF_pol_x, compactSchema, basketBytes);
+  branchColumn(t, "OP_pol_y", mP_pol_y, mF_pol_y, compactSchema, basketBytes);
+  branchColumn(t, "OP_pol_z", mP_pol_z, mF_pol_z, compactSchema, basketBytes);
+}
 
 // ########################################################################
 void CaloTree::BeginEvent()
 {
-  // This is clled from PrimaryGeneratorAction::GeneratePrimaries,
-  // not from B4aEventAction..
+  // This is called from B4bEventAction::BeginOfEventAction, after
+  // PrimaryGeneratorAction::GeneratePrimaries (which calls seedEvent).
   // clearCaloHits();
   clearCaloTree();
+
+  //  the next shard is opened with its first event, so that a job never
+  //  ends with an empty one.
+  if (!fout)
+    openShard();
+  CaloShardIndex::Shard &shard = shardIndex->current();
+  if (shard.events == 0)
+  {
+    shard.seeds[0] = eventSeeds[0];
+    shard.seeds[1] = eventSeeds[1];
+  }
 }
 
 // ########################################################################
@@ -291,8 +646,27 @@ void CaloTree::EndEvent()
 
   m_run = 1;
   m_event = eventCounts;
+  m_seed0 = eventSeeds[0];
+  m_seed1 = eventSeeds[1];
+
+  bool inNtuple = eventInNtuple(eventCounts);
+
+  //   SiPM channel hits (the stream gets them for every event)
+  if (inNtuple || streamWriter)
+    fillChannelHits();
 
-  if ((eventCounts - 1) < getParamI("eventsInNtupe"))
+  //   SiPM image of this event (all events, not only those in the ntuple)
+  if (photonImage)
+  {
+    for (auto itr = photonData.begin(); itr != photonData.end(); itr++)
+      photonImage->add(*itr);
+  }
+
+  //   before tree->fill(): an async writer takes the vectors with it.
+  if (streamWriter)
+    publishEvent();
+
+  if (inNtuple)
   {
     m_beamMinE = getParamF("gun_energy_min");
     m_beamMaxE = getParamF("gun_energy_max");
@@ -313,123 +687,326 @@ void CaloTree::EndEvent()
     m_beamZ = beamZ;
     m_beamE = beamE;
     m_beamID = beamID;
+    m_beamDx = beamDx;
+    m_beamDy = beamDy;
+    m_beamDz = beamDz;
     m_beamType = beamType;
 
-    //  CC:  Cherenkov hits (ncer)
-    m_sum3dCC = 0.0;
-    for (auto itr = ctHits.begin(); itr != ctHits.end(); itr++)
-    {
-      CaloID id(itr->first);
-      int area = id.area(); // 0=Al-block, 1=no-SiPM, 2=6mm, 3=3mm
-      if (area < 2)
-        continue;
-      double ncer = itr->second;
-      if (round(ncer) < 1.0)
-        continue; // 1.0 cherenkov photon cut
-      m_sum3dCC = m_sum3dCC + ncer;
-      // m_ky3dCC.push_back(itr->first);  // this used for debugging.
-      int ky = id.iy() * 10; // 6mm SiPM
-      if (area == 3)
-      {
-        ky = ky + id.iyy() + 1;
-      } // 3mm SiPM
-      m_id3dCC.push_back(id.ix() * 10000000 + ky * 1000 + id.tslice());
-      m_type3dCC.push_back(id.type());
-      m_area3dCC.push_back(id.area());
-      m_ix3dCC.push_back(id.ix());
-      m_iy3dCC.push_back(id.iy());
-      m_ixx3dCC.push_back(id.ixx());
-      m_iyy3dCC.push_back(id.iyy());
-      m_zslice3dCC.push_back(id.zslice());
-      m_tslice3dCC.push_back(id.tslice());
-      m_ph3dCC.push_back(round(ncer));
-    }
-    m_nhits3dCC = m_ph3dCC.size();
-
-    //  SS: Scintillation hits (edepbirk)...
-    m_sum3dSS = 0.0;
-    for (auto itr = stHits.begin(); itr != stHits.end(); itr++)
-    {
-      CaloID id(itr->first);
-      int area = id.area(); // 0=Al-block, 1=no-SiPM, 2=6mm, 3=3mm
-      if (area < 2)
-        continue;
-      double edepbirk = itr->second;
-      if (edepbirk < 0.0001)
-        continue; // 0.1 kev cut
-      m_sum3dSS = m_sum3dSS + edepbirk;
-      int ky = id.iy() * 10; // 6mm SiPM
-      if (area == 3)
-      {
-        ky = ky + id.iyy() + 1;
-      } // 3mm SiPM
-      m_id3dSS.push_back(id.ix() * 10000000 + ky * 1000 + id.tslice());
-      m_type3dSS.push_back(id.type());
-      m_area3dSS.push_back(id.area());
-      m_ix3dSS.push_back(id.ix());
-      m_iy3dSS.push_back(id.iy());
-      m_ixx3dSS.push_back(id.ixx());
-      m_iyy3dSS.push_back(id.iyy());
-      m_zslice3dSS.push_back(id.zslice());
-      m_tslice3dSS.push_back(id.tslice());
-      m_ph3dSS.push_back(edepbirk);
-    }
-    m_nhits3dSS = m_ph3dSS.size();
-
+    if (saveTruthHits && compactTruthHits)
+      fillCompactTruth();
     m_nhitstruth = m_pidtruth.size();
 
-    // optical photon hits
-    for (auto const photon : photonData)
+    // optical photon hits (those not already spilled to spillTree)
+    if (outputTier >= kTierFull)
     {
-      // if (photon.exitTime == 0.0)
-      //   continue;
-      mP_trackid.push_back(photon.trackID);
-      mP_pos_produced_x.push_back(photon.productionPosition.x());
-      mP_pos_produced_y.push_back(photon.productionPosition.y());
-      mP_pos_produced_z.push_back(photon.productionPosition.z());
-      mP_mom_produced_x.push_back(photon.productionMomentum.x());
-      mP_mom_produced_y.push_back(photon.productionMomentum.y());
-      mP_mom_produced_z.push_back(photon.productionMomentum.z());
-      mP_pos_final_x.push_back(photon.exitPosition.x());
-      mP_pos_final_y.push_back(photon.exitPosition.y());
-      mP_pos_final_z.push_back(photon.exitPosition.z());
-      mP_mom_final_x.push_back(photon.exitMomentum.x());
-      mP_mom_final_y.push_back(photon.exitMomentum.y());
-      mP_mom_final_z.push_back(photon.exitMomentum.z());
-      mP_time_produced.push_back(photon.productionTime);
-      mP_time_final.push_back(photon.exitTime);
-      mP_isCerenkov.push_back(photon.isCerenkov);
-      mP_isScintillation.push_back(photon.isScintillation);
-      mP_productionFiber.push_back(photon.productionFiber);
-      mP_finalFiber.push_back(photon.exitFiber);
-      mP_isCoreC.push_back(photon.isCoreC);
-      mP_isCoreS.push_back(photon.isCoreS);
-      mP_isCladC.push_back(photon.isCladC);
-      mP_isCladS.push_back(photon.isCladS);
-      mP_pol_x.push_back(photon.polarization.x());
-      mP_pol_y.push_back(photon.polarization.y());
-      mP_pol_z.push_back(photon.polarization.z());
-
-      // std::cout << "Propagation length in z " << photon.exitPosition.z() - photon.productionPosition.z() << " speed " << (photon.exitTime - photon.productionTime) / (photon.exitPosition.z() - photon.productionPosition.z()) << " costheta " << photon.productionMomentum.z() / photon.productionMomentum.mag() << std::endl;
+      fillPhotonVectors(photonData.begin(), photonData.end());
+      mP_nOPs = photonData.size() + mP_nOPspilled;
     }
-    mP_nOPs = photonData.size();
 
     //
-    tree->Fill();
+    tree->fill();
     std::cout << "Look into energy deposition in the calorimeter..." << std::endl;
     std::cout << "  eCalo=" << m_eCalotruth << "  eWorld=" << m_eWorldtruth << "  eLeak=" << m_eLeaktruth << "  eInvisible=" << m_eInvisible << "  eRod=" << m_eRodtruth << "  eCen=" << m_eCentruth << "  eScin=" << m_eScintruth << " eCalo+eWorld+eLeak+eInvisible=" << (m_eCalotruth + m_eWorldtruth + m_eLeaktruth + m_eInvisible) << std::endl;
   } //  end of if((eventCounts-1)<getParamI("eventsInNtupe"))
 
+  if (imageWriter)
+    imageWriter->endEvent(*photonImage, beamE, beamID);
+
   //   analyze this event.
   analyze();
+
+  if (catalog)
+  {
+    CaloCatalogRecord rec = {};
+    rec.entry = inNtuple ? tree->fillCount() - 1 : -1;
+    rec.file = catalogFile;
+    rec.run = m_run;
+    rec.event = m_event;
+    rec.beamID = beamID;
+    rec.seeds[0] = eventSeeds[0];
+    rec.seeds[1] = eventSeeds[1];
+    rec.beamE = beamE;
+    rec.beamX = beamX;
+    rec.beamY = beamY;
+    rec.beamZ = beamZ;
+    catalog->add(rec);
+  }
+
+  CaloShardIndex::Shard &shard = shardIndex->current();
+  if (shard.events == 0)
+    shard.firstEvent = eventCounts;
+  shard.lastEvent = eventCounts;
+  shard.events++;
+  if (inNtuple)
+    shard.ntupleEvents++;
+
+  long long shardBytes = tree->fileBytes();
+  if (spillTree)
+    shardBytes = max(shardBytes, spillTree->fileBytes());
+  if ((shardMaxEvents > 0 && shard.events >= shardMaxEvents) ||
+      (shardMaxBytes > 0 && shardBytes >= shardMaxBytes))
+    closeShard();
+
+  if (checkpointEvents > 0 && eventCountsALL % checkpointEvents == 0 &&
+      eventCountsALL < getParamI("numberOfEvents"))
+    writeCheckpoint();
+}
+
+// ########################################################################
+void CaloTree::fillChannelHits()
+{
+  //  CC:  Cherenkov hits (ncer)
+  m_sum3dCC = 0.0;
+  for (auto itr = ctHits.begin(); itr != ctHits.end(); itr++)
+  {
+    CaloID id(itr->first);
+    int area = id.area(); // 0=Al-block, 1=no-SiPM, 2=6mm, 3=3mm
+    if (area < 2)
+      continue;
+    double ncer = itr->second;
+    if (round(ncer) < 1.0)
+      continue; // 1.0 cherenkov photon cut
+    m_sum3dCC = m_sum3dCC + ncer;
+    m_nhits3dCC++;
+    if (outputTier < kTierChannels && !streamWriter)
+      continue; // summary tier: count and sum only
+    // m_ky3dCC.push_back(itr->first);  // this used for debugging.
+    int ky = id.iy() * 10; // 6mm SiPM
+    if (area == 3)
+    {
+      ky = ky + id.iyy() + 1;
+    } // 3mm SiPM
+    // xxxyyyttt packing only has 3 digits for the slice; tslice3dCC keeps the full value.
+    m_id3dCC.push_back(id.ix() * 10000000 + ky * 1000 + min(id.tslice(), 999));
+    m_type3dCC.push_back(id.type());
+    m_area3dCC.push_back(id.area());
+    m_ix3dCC.push_back(id.ix());
+    m_iy3dCC.push_back(id.iy());
+    m_ixx3dCC.push_back(id.ixx());
+    m_iyy3dCC.push_back(id.iyy());
+    m_zslice3dCC.push_back(id.zslice());
+    m_tslice3dCC.push_back(id.tslice());
+    m_ph3dCC.push_back(round(ncer));
+  }
+
+  //  SS: Scintillation hits (edepbirk)...
+  m_sum3dSS = 0.0;
+  for (auto itr = stHits.begin(); itr != stHits.end(); itr++)
+  {
+    CaloID id(itr->first);
+    int area = id.area(); // 0=Al-block, 1=no-SiPM, 2=6mm, 3=3mm
+    if (area < 2)
+      continue;
+    double edepbirk = itr->second;
+    if (edepbirk < 0.0001)
+      continue; // 0.1 kev cut
+    m_sum3dSS = m_sum3dSS + edepbirk;
+    m_nhits3dSS++;
+    if (outputTier < kTierChannels && !streamWriter)
+      continue; // summary tier: count and sum only
+    int ky = id.iy() * 10; // 6mm SiPM
+    if (area == 3)
+    {
+      ky = ky + id.iyy() + 1;
+    } // 3mm SiPM
+    m_id3dSS.push_back(id.ix() * 10000000 + ky * 1000 + min(id.tslice(), 999));
+    m_type3dSS.push_back(id.type());
+    m_area3dSS.push_back(id.area());
+    m_ix3dSS.push_back(id.ix());
+    m_iy3dSS.push_back(id.iy());
+    m_ixx3dSS.push_back(id.ixx());
+    m_iyy3dSS.push_back(id.iyy());
+    m_zslice3dSS.push_back(id.zslice());
+    m_tslice3dSS.push_back(id.tslice());
+    m_ph3dSS.push_back(edepbirk);
+  }
+}
+
+// ########################################################################
+void CaloTree::publishEvent()
+{
+  // one record on the stream socket: SiPM channels and photon-exit image.
+  CaloStreamHeader header = {};
+  header.run = m_run;
+  header.event = m_event;
+  header.beamID = beamID;
+  header.beamE = beamE;
+  header.beamX = beamX;
+  header.beamY = beamY;
+  header.beamZ = beamZ;
+  header.sum3dSS = m_sum3dSS;
+  header.sum3dCC = m_sum3dCC;
+
+  streamSS.clear();
+  for (size_t i = 0; i < m_id3dSS.size(); i++)
+    streamSS.push_back({m_id3dSS[i], m_ph3dSS[i]});
+  streamCC.clear();
+  for (size_t i = 0; i < m_id3dCC.size(); i++)
+    streamCC.push_back({m_id3dCC[i], m_ph3dCC[i]});
+
+  if (photonImage)
+    streamWriter->publish(header, streamSS, streamCC, &photonImage->data(), photonImage->sizeX(), photonImage->sizeY());
+  else
+    streamWriter->publish(header, streamSS, streamCC, nullptr, 0, 0);
 }
 
 // ########################################################################
 void CaloTree::EndJob()
 {
-  fout->Write();
-  fout->Close();
+  std::cout << "CaloTree::EndJob: event arena peak " << (eventArena.peakBytes() >> 20)
+            << " MB, overflowed in " << eventArena.overflowEvents() << " events" << std::endl;
+  if (ioThread)
+  {
+    ioThread->stop();
+    std::cout << "CaloTree::EndJob: async writer " << ioThread->submitted() << " records, I/O thread busy "
+              << ioThread->busySeconds() << " s, max queued " << ioThread->maxQueued()
+              << ", simulation blocked " << ioThread->blocked() << " times for "
+              << ioThread->blockedSeconds() << " s" << std::endl;
+  }
+  if (fout)
+    closeShard();
+  std::cout << "CaloTree::EndJob: " << (useRNTuple ? "rntuple" : "ttree") << " fill "
+            << fillSeconds << " s for " << fillCount << " events, " << shardIndex->size()
+            << " output file(s) listed in " << outBaseName << "_index.json" << std::endl;
+  if (catalog)
+  {
+    catalog->close();
+    std::cout << "CaloTree::EndJob: " << catalog->size() << " events in " << outBaseName << "_catalog.cxc"
+              << std::endl;
+  }
+  if (imageWriter)
+  {
+    imageWriter->close();
+    std::cout << "CaloTree::EndJob: " << imageWriter->eventsWritten() << " SiPM images written" << std::endl;
+  }
+  if (streamWriter)
+  {
+    streamWriter->close();
+    std::cout << "CaloTree::EndJob: stream " << streamWriter->published() << " events published, "
+              << streamWriter->dropped() << " dropped (no consumer)" << std::endl;
+  }
+}
+// ########################################################################
+void CaloTree::writeCheckpoint()
+{
+  // all events so far on disk: shard, catalog and index.
+  if (fout)
+    closeShard();
+
+  // the engine file is new for every checkpoint, the .txt naming it is
+  // replaced last: an interrupted checkpoint leaves the previous one valid.
+  string engineFile = checkpointName + "_" + std::to_string(eventCountsALL) + ".rndm";
+  G4Random::saveEngineStatus(engineFile.c_str());
+
+  string tmp = checkpointName + ".txt.tmp";
+  ofstream out(tmp);
+  out << "engine " << engineFile << "\n";
+  out << "eventCounts " << eventCounts << "\n";
+  out << "eventCountsALL " << eventCountsALL << "\n";
+  out << "py8eventNumber " << py8Event << "\n";
+  out << "catalogEvents " << (catalog ? catalog->size() : 0) << "\n";
+  out << "catalogFiles " << (catalog ? catalog->fileCount() : 0) << "\n";
+  for (int i = 0; i < shardIndex->size(); i++)
+  {
+    const CaloShardIndex::Shard &sh = shardIndex->shard(i);
+    out << "shard " << sh.file << " " << sh.firstEvent << " " << sh.lastEvent << " " << sh.events << " "
+        << sh.ntupleEvents << " " << sh.seeds[0] << " " << sh.seeds[1] << " " << sh.bytes << "\n";
+  }
+  out.close();
+  if (!out || std::rename(tmp.c_str(), (checkpointName + ".txt").c_str()) != 0)
+  {
+    std::cout << "CaloTree: checkpoint " << checkpointName << ".txt not written" << std::endl;
+    return;
+  }
+  if (!checkpointEngine.empty())
+    std::remove(checkpointEngine.c_str());
+  checkpointEngine = engineFile;
+  std::cout << "CaloTree: checkpoint after " << eventCountsALL << " events" << std::endl;
 }
+
+// ########################################################################
+void CaloTree::readCheckpoint(long &catalogEvents, int &catalogFiles)
+{
+  ifstream in(checkpointName + ".txt");
+  if (!in.is_open())
+  {
+    std::cout << "CaloTree: resume true, but there is no " << checkpointName << ".txt. Exit.." << std::endl;
+    std::exit(0);
+  }
+  string key;
+  while (in >> key)
+  {
+    if (key == "engine")
+      in >> checkpointEngine;
+    else if (key == "eventCounts")
+      in >> eventCounts;
+    else if (key == "eventCountsALL")
+      in >> eventCountsALL;
+    else if (key == "py8eventNumber")
+      in >> py8Event;
+    else if (key == "catalogEvents")
+      in >> catalogEvents;
+    else if (key == "catalogFiles")
+      in >> catalogFiles;
+    else if (key == "shard")
+    {
+      CaloShardIndex::Shard sh;
+      in >> sh.file >> sh.firstEvent >> sh.lastEvent >> sh.events >> sh.ntupleEvents >> sh.seeds[0] >>
+          sh.seeds[1] >> sh.bytes;
+      shardIndex->restore(sh);
+    }
+  }
+  std::cout << "CaloTree: resuming after " << eventCountsALL << " events, " << shardIndex->size()
+            << " shard(s) done" << std::endl;
+}
+
+// ########################################################################
+void CaloTree::resumeEngine()
+{
+  if (!resumed)
+    return;
+  G4Random::restoreEngineStatus(checkpointEngine.c_str());
+  G4Random::showEngineStatus();
+}
+
+// ########################################################################
+int CaloTree::eventsToRun()
+{
+  if (replayEvent > 0)
+    return 1;
+  return max(getParamI("numberOfEvents") - eventCountsALL, 0);
+}
+
+// ########################################################################
+void CaloTree::seedEvent()
+{
+  // called before the primaries are generated: every random number of the
+  // event comes from seeds that depend on nothing but the event number.
+  // With one stream per job, the engine state here reproduces the event
+  // (BeginEvent runs after the primaries have drawn their numbers).
+  if (!perEventSeeds)
+  {
+    const long *seeds = G4Random::getTheEngine()->getSeeds();
+    eventSeeds[0] = seeds[0];
+    eventSeeds[1] = seeds[1];
+    return;
+  }
+  std::uint64_t h = splitmix64(std::uint64_t(getParamI("runNumber")));
+  h = splitmix64(h ^ std::uint64_t(getParamI("runSeq")));
+  h = splitmix64(h ^ std::uint64_t(eventCountsALL + 1));
+  // RanecuEngine seeds: 1 .. modulus-1 of its two generators
+  eventSeeds[0] = 1 + long((h & 0xffffffff) % 2147483562);
+  eventSeeds[1] = 1 + long((h >> 32) % 2147483398);
+  G4Random::setTheSeeds(eventSeeds);
+}
+
+// ########################################################################
+void CaloTree::setRunSeeds(long s0, long s1)
+{
+  shardIndex->setRunSeeds(s0, s1);
+  shardIndex->write();
+}
+
 // ########################################################################
 void CaloTree::saveBeamXYZE(string ptype, int pdgid, float x, float y, float z,
                             float en)
@@ -442,6 +1019,114 @@ void CaloTree::saveBeamXYZE(string ptype, int pdgid, float x, float y, float z,
   beamE = en; // in MeV
 }
 
+// ########################################################################
+void CaloTree::saveBeamDirection(float dx, float dy, float dz)
+{
+  beamDx = dx; // unit vector
+  beamDy = dy;
+  beamDz = dz;
+}
+
+// ########################################################################
+void CaloTree::fillPhotonVectors(PhotonVector::const_iterator first, PhotonVector::const_iterator last)
+{
+  for (auto itr = first; itr != last; itr++)
+  {
+    const PhotonInfo &photon = *itr;
+    // if (photon.exitTime == 0.0)
+    //   continue;
+    mP_trackid.push_back(photon.trackID);
+    pushColumn(mP_pos_produced_x, mF_pos_produced_x, compactSchema, photon.productionPosition.x());
+    pushColumn(mP_pos_produced_y, mF_pos_produced_y, compactSchema, photon.productionPosition.y());
+    pushColumn(mP_pos_produced_z, mF_pos_produced_z, compactSchema, photon.productionPosition.z());
+    pushColumn(mP_mom_produced_x, mF_mom_produced_x, compactSchema, photon.productionMomentum.x());
+    pushColumn(mP_mom_produced_y, mF_mom_produced_y, compactSchema, photon.productionMomentum.y());
+    pushColumn(mP_mom_produced_z, mF_mom_produced_z, compactSchema, photon.productionMomentum.z());
+    pushColumn(mP_pos_final_x, mF_pos_final_x, compactSchema, photon.exitPosition.x());
+    pushColumn(mP_pos_final_y, mF_pos_final_y, compactSchema, photon.exitPosition.y());
+    pushColumn(mP_pos_final_z, mF_pos_final_z, compactSchema, photon.exitPosition.z());
+    pushColumn(mP_mom_final_x, mF_mom_final_x, compactSchema, photon.exitMomentum.x());
+    pushColumn(mP_mom_final_y, mF_mom_final_y, compactSchema, photon.exitMomentum.y());
+    pushColumn(mP_mom_final_z, mF_mom_final_z, compactSchema, photon.exitMomentum.z());
+    pushColumn(mP_time_produced, mF_time_produced, compactSchema, photon.productionTime);
+    pushColumn(mP_time_final, mF_time_final, compactSchema, photon.exitTime);
+    if (compactSchema)
+    {
+      mP_flags.push_back(packOPFlags(photon));
+    }
+    else
+    {
+      mP_isCerenkov.push_back(photon.isCerenkov);
+      mP_isScintillation.push_back(photon.isScintillation);
+      mP_productionFiber.push_back(photon.productionFiber);
+      mP_finalFiber.push_back(photon.exitFiber);
+      mP_isCoreC.push_back(photon.isCoreC);
+      mP_isCoreS.push_back(photon.isCoreS);
+      mP_isCladC.push_back(photon.isCladC);
+      mP_isCladS.push_back(photon.isCladS);
+    }
+    pushColumn(mP_pol_x, mF_pol_x, compactSchema, photon.polarization.x());
+    pushColumn(mP_pol_y, mF_pol_y, compactSchema, photon.polarization.y());
+    pushColumn(mP_pol_z, mF_pol_z, compactSchema, photon.polarization.z());
+
+    // std::cout << "Propagation length in z " << photon.exitPosition.z() - photon.productionPosition.z() << " speed " << (photon.exitTime - photon.productionTime) / (photon.exitPosition.z() - photon.productionPosition.z()) << " costheta " << photon.productionMomentum.z() / photon.productionMomentum.mag() << std::endl;
+  }
+}
+
+// ########################################################################
+bool CaloTree::eventInNtuple(int event)
+{
+  // the first eventsInNtupe events, and a replayed one whatever its number
+  return event <= getParamI("eventsInNtupe") || replayEvent > 0;
+}
+
+// ########################################################################
+void CaloTree::checkPhotonBudget(int activeTrackID)
+{
+  // called from SteppingAction when a new photon is recorded.
+  // Geant4 tracks one photon to its end before starting the next one, so
+  // every photon except the one being tracked already has its exit record
+  // or has been killed, and can be flushed.
+  if (photonBudgetBytes == 0 || photonData.size() * sizeof(PhotonInfo) < photonBudgetBytes)
+    return;
+
+  PhotonInfo active;
+  bool hasActive = false;
+  if (!photonData.empty() && photonData.back().trackID == activeTrackID)
+  {
+    active = photonData.back();
+    hasActive = true;
+    photonData.pop_back();
+  }
+
+  if (photonImage)
+  {
+    for (auto itr = photonData.begin(); itr != photonData.end(); itr++)
+      photonImage->add(*itr);
+  }
+
+  if (spillTree && eventInNtuple(eventCounts + 1))
+  {
+    // this event goes into the ntuple: write the chunk.
+    fillPhotonVectors(photonData.begin(), photonData.end());
+    m_run = 1;
+    m_event = eventCounts + 1;
+    mP_chunk = mP_nOPchunks;
+    mP_nOPs = photonData.size();
+    spillTree->fill();
+
+    mP_nOPchunks++;
+    mP_nOPspilled += photonData.size();
+    resetPhotonVectors();
+  }
+
+  // keep the buffer: it already holds one budget, and the arena would not
+  // reuse a freed one within the event.
+  photonData.clear();
+  if (hasActive)
+    photonData.push_back(active);
+}
+
 // ########################################################################
 void CaloTree::clearCaloTree()
 {
@@ -464,27 +1149,38 @@ void CaloTree::clearCaloTree()
   m_beamZ = 0.0;
   m_beamE = 0.0;
   m_beamID = 0;
+  m_beamDx = 0.0;
+  m_beamDy = 0.0;
+  m_beamDz = 0.0;
   m_beamType = " ";
 
   m_nhitstruth = 0;
-  m_pidtruth.clear();
-  m_trackidtruth.clear();
-  m_calotypetruth.clear();
-  m_xtruth.clear();
-  m_ytruth.clear();
-  m_ztruth.clear();
-  m_steplengthtruth.clear();
-  m_globaltimetruth.clear();
-  m_localtimetruth.clear();
-  m_edeptruth.clear();
-  m_edepNonIontruth.clear();
-  m_edepInvtruth.clear();
-  m_edepbirktruth.clear();
-  m_ncertruth.clear();
-  m_ncercaptruth.clear();
-  m_layerNumber.clear();
-  m_rodNumber.clear();
-  m_fiberNumber.clear();
+  resetVector(m_pidtruth, vectorMaxBytes);
+  resetVector(m_trackidtruth, vectorMaxBytes);
+  resetVector(m_calotypetruth, vectorMaxBytes);
+  resetVector(m_xtruth, vectorMaxBytes);
+  resetVector(m_ytruth, vectorMaxBytes);
+  resetVector(m_ztruth, vectorMaxBytes);
+  resetVector(m_steplengthtruth, vectorMaxBytes);
+  resetVector(m_globaltimetruth, vectorMaxBytes);
+  resetVector(m_localtimetruth, vectorMaxBytes);
+  resetVector(m_edeptruth, vectorMaxBytes);
+  resetVector(m_edepNonIontruth, vectorMaxBytes);
+  resetVector(m_edepInvtruth, vectorMaxBytes);
+  resetVector(m_edepbirktruth, vectorMaxBytes);
+  resetVector(m_ncertruth, vectorMaxBytes);
+  resetVector(m_ncercaptruth, vectorMaxBytes);
+  resetVector(m_layerNumber, vectorMaxBytes);
+  resetVector(m_rodNumber, vectorMaxBytes);
+  resetVector(m_fiberNumber, vectorMaxBytes);
+  resetVector(m_nstepstruth, vectorMaxBytes);
+  resetVector(m_xtruthF, vectorMaxBytes);
+  resetVector(m_ytruthF, vectorMaxBytes);
+  resetVector(m_ztruthF, vectorMaxBytes);
+  resetVector(m_steplengthtruthF, vectorMaxBytes);
+  resetVector(m_globaltimetruthF, vectorMaxBytes);
+  resetVector(m_localtimetruthF, vectorMaxBytes);
+  truthDeposits.clear();
 
   m_eCalotruth = 0.0;
   m_eWorldtruth = 0.0;
@@ -495,79 +1191,158 @@ void CaloTree::clearCaloTree()
   m_eScintruth = 0.0;
 
   m_nhits3dSS = 0;
-  m_id3dSS.clear();
-  m_type3dSS.clear();
-  m_area3dSS.clear();
-  m_ix3dSS.clear();
-  m_iy3dSS.clear();
-  m_ixx3dSS.clear();
-  m_iyy3dSS.clear();
-  m_zslice3dSS.clear();
-  m_tslice3dSS.clear();
-  m_ph3dSS.clear();
+  resetVector(m_id3dSS, vectorMaxBytes);
+  resetVector(m_type3dSS, vectorMaxBytes);
+  resetVector(m_area3dSS, vectorMaxBytes);
+  resetVector(m_ix3dSS, vectorMaxBytes);
+  resetVector(m_iy3dSS, vectorMaxBytes);
+  resetVector(m_ixx3dSS, vectorMaxBytes);
+  resetVector(m_iyy3dSS, vectorMaxBytes);
+  resetVector(m_zslice3dSS, vectorMaxBytes);
+  resetVector(m_tslice3dSS, vectorMaxBytes);
+  resetVector(m_ph3dSS, vectorMaxBytes);
   m_sum3dSS = 0.0;
 
   m_nhits3dCC = 0;
   //  m_ky3dCC.clear();   // this used for debugging.
-  m_id3dCC.clear();
-  m_type3dCC.clear();
-  m_area3dCC.clear();
-  m_ix3dCC.clear();
-  m_iy3dCC.clear();
-  m_ixx3dCC.clear();
-  m_iyy3dCC.clear();
-  m_zslice3dCC.clear();
-  m_tslice3dCC.clear();
-  m_ph3dCC.clear();
+  resetVector(m_id3dCC, vectorMaxBytes);
+  resetVector(m_type3dCC, vectorMaxBytes);
+  resetVector(m_area3dCC, vectorMaxBytes);
+  resetVector(m_ix3dCC, vectorMaxBytes);
+  resetVector(m_iy3dCC, vectorMaxBytes);
+  resetVector(m_ixx3dCC, vectorMaxBytes);
+  resetVector(m_iyy3dCC, vectorMaxBytes);
+  resetVector(m_zslice3dCC, vectorMaxBytes);
+  resetVector(m_tslice3dCC, vectorMaxBytes);
+  resetVector(m_ph3dCC, vectorMaxBytes);
   m_sum3dCC = 0.0;
 
   // clean photons
-  photonData.clear();
+  PhotonVector(&eventArena).swap(photonData);
   mP_nOPs = 0;
-  mP_trackid.clear();
-  mP_pos_produced_x.clear();
-  mP_pos_produced_y.clear();
-  mP_pos_produced_z.clear();
-  mP_mom_produced_x.clear();
-  mP_mom_produced_y.clear();
-  mP_mom_produced_z.clear();
-  mP_pos_final_x.clear();
-  mP_pos_final_y.clear();
-  mP_pos_final_z.clear();
-  mP_mom_final_x.clear();
-  mP_mom_final_y.clear();
-  mP_mom_final_z.clear();
-  mP_time_produced.clear();
-  mP_time_final.clear();
-  mP_isCerenkov.clear();
-  mP_isScintillation.clear();
-  mP_productionFiber.clear();
-  mP_finalFiber.clear();
-  mP_isCoreC.clear();
-  mP_isCoreS.clear();
-  mP_isCladC.clear();
-  mP_isCladS.clear();
-  mP_pol_x.clear();
-  mP_pol_y.clear();
-  mP_pol_z.clear();
+  mP_nOPspilled = 0;
+  mP_nOPchunks = 0;
+  resetPhotonVectors();
+
+  if (photonImage)
+    photonImage->clear();
+
+  //  all arena users are empty now: rewind it and free any overflow.
+  eventArena.reset();
+}
+
+// ########################################################################
+void CaloTree::resetPhotonVectors()
+{
+  resetVector(mP_trackid, vectorMaxBytes);
+  resetVector(mP_pos_produced_x, vectorMaxBytes);
+  resetVector(mP_pos_produced_y, vectorMaxBytes);
+  resetVector(mP_pos_produced_z, vectorMaxBytes);
+  resetVector(mP_mom_produced_x, vectorMaxBytes);
+  resetVector(mP_mom_produced_y, vectorMaxBytes);
+  resetVector(mP_mom_produced_z, vectorMaxBytes);
+  resetVector(mP_pos_final_x, vectorMaxBytes);
+  resetVector(mP_pos_final_y, vectorMaxBytes);
+  resetVector(mP_pos_final_z, vectorMaxBytes);
+  resetVector(mP_mom_final_x, vectorMaxBytes);
+  resetVector(mP_mom_final_y, vectorMaxBytes);
+  resetVector(mP_mom_final_z, vectorMaxBytes);
+  resetVector(mP_time_produced, vectorMaxBytes);
+  resetVector(mP_time_final, vectorMaxBytes);
+  resetVector(mP_isCerenkov, vectorMaxBytes);
+  resetVector(mP_isScintillation, vectorMaxBytes);
+  resetVector(mP_productionFiber, vectorMaxBytes);
+  resetVector(mP_finalFiber, vectorMaxBytes);
+  resetVector(mP_isCoreC, vectorMaxBytes);
+  resetVector(mP_isCoreS, vectorMaxBytes);
+  resetVector(mP_isCladC, vectorMaxBytes);
+  resetVector(mP_isCladS, vectorMaxBytes);
+  resetVector(mP_pol_x, vectorMaxBytes);
+  resetVector(mP_pol_y, vectorMaxBytes);
+  resetVector(mP_pol_z, vectorMaxBytes);
+
+  resetVector(mP_flags, vectorMaxBytes);
+  resetVector(mF_pos_produced_x, vectorMaxBytes);
+  resetVector(mF_pos_produced_y, vectorMaxBytes);
+  resetVector(mF_pos_produced_z, vectorMaxBytes);
+  resetVector(mF_mom_produced_x, vectorMaxBytes);
+  resetVector(mF_mom_produced_y, vectorMaxBytes);
+  resetVector(mF_mom_produced_z, vectorMaxBytes);
+  resetVector(mF_pos_final_x, vectorMaxBytes);
+  resetVector(mF_pos_final_y, vectorMaxBytes);
+  resetVector(mF_pos_final_z, vectorMaxBytes);
+  resetVector(mF_mom_final_x, vectorMaxBytes);
+  resetVector(mF_mom_final_y, vectorMaxBytes);
+  resetVector(mF_mom_final_z, vectorMaxBytes);
+  resetVector(mF_time_produced, vectorMaxBytes);
+  resetVector(mF_time_final, vectorMaxBytes);
+  resetVector(mF_pol_x, vectorMaxBytes);
+  resetVector(mF_pol_y, vectorMaxBytes);
+  resetVector(mF_pol_z, vectorMaxBytes);
 }
 
 // ########################################################################
 void CaloTree::accumulateHits(CaloHit ah)
 {
-  if (saveTruthHits && ah.calotype > 1 && ah.edep >= 1.0e-6)
+  if (saveTruthHits && compactTruthHits && ah.calotype > 1 && ah.edep >= 1.0e-6)
+  {
+    // merge steps in the same fiber and fine (z, t) cell.
+    // key: see TruthKey (layer and rod fit, checked at setup), z (cm) offset by 500 cm
+    const int rodShift = 2 + TruthKey::kLayerBits;
+    const int fiberShift = rodShift + TruthKey::kRodBits;
+    std::uint64_t zbin = std::uint64_t(max(0.0, floor((ah.z + 500.0) / truthCompactDz)));
+    std::uint64_t tbin = std::uint64_t(max(0.0, floor(ah.globaltime / truthCompactDt)));
+    zbin = min(zbin, (std::uint64_t(1) << 20) - 1);
+    tbin = min(tbin, (std::uint64_t(1) << 22) - 1);
+    const std::uint64_t layerMask = (1 << TruthKey::kLayerBits) - 1;
+    const std::uint64_t rodMask = (1 << TruthKey::kRodBits) - 1;
+    std::uint64_t key = std::uint64_t(ah.calotype & 0x3) | ((std::uint64_t(ah.layerNumber) & layerMask) << 2) |
+                        ((std::uint64_t(ah.rodNumber) & rodMask) << rodShift) |
+                        (std::uint64_t(ah.fiberNumber & 0xf) << fiberShift) | (zbin << (fiberShift + 4)) |
+                        (tbin << (fiberShift + 24));
+
+    auto ins = truthDeposits.try_emplace(key, TruthDeposit{});
+    TruthDeposit &d = ins.first->second;
+    if (ins.second)
+    {
+      d.calotype = ah.calotype;
+      d.layerNumber = ah.layerNumber;
+      d.rodNumber = ah.rodNumber;
+      d.fiberNumber = ah.fiberNumber;
+    }
+    if (ah.edep > d.edepMax)
+    {
+      d.edepMax = ah.edep;
+      d.pid = ah.pid;
+      d.trackid = ah.trackid;
+    }
+    d.nsteps++;
+    d.edep += ah.edep;
+    d.edepNonIon += ah.edepNonIon;
+    d.edepInv += ah.edepInv;
+    d.edepbirk += ah.edepbirk;
+    d.ncer += ah.ncer;
+    d.ncercap += ah.ncercap;
+    d.wx += ah.edep * ah.x;
+    d.wy += ah.edep * ah.y;
+    d.wz += ah.edep * ah.z;
+    d.wsteplength += ah.edep * ah.steplength;
+    d.wglobaltime += ah.edep * ah.globaltime;
+    d.wlocaltime += ah.edep * ah.localtime;
+  }
+  else if (saveTruthHits && ah.calotype > 1 && ah.edep >= 1.0e-6)
   {
     // save the truth hit in the scintillating and cherenkov fibers.
     // larger than 1 eV
     m_pidtruth.push_back(ah.pid);
     m_trackidtruth.push_back(ah.trackid);
     m_calotypetruth.push_back(ah.calotype);
-    m_xtruth.push_back(ah.x);
-    m_ytruth.push_back(ah.y);
-    m_ztruth.push_back(ah.z);
-    m_steplengthtruth.push_back(ah.steplength);
-    m_globaltimetruth.push_back(ah.globaltime);
-    m_localtimetruth.push_back(ah.localtime);
+    pushColumn(m_xtruth, m_xtruthF, compactSchema, ah.x);
+    pushColumn(m_ytruth, m_ytruthF, compactSchema, ah.y);
+    pushColumn(m_ztruth, m_ztruthF, compactSchema, ah.z);
+    pushColumn(m_steplengthtruth, m_steplengthtruthF, compactSchema, ah.steplength);
+    pushColumn(m_globaltimetruth, m_globaltimetruthF, compactSchema, ah.globaltime);
+    pushColumn(m_localtimetruth, m_localtimetruthF, compactSchema, ah.localtime);
     m_edeptruth.push_back(ah.edep);
     m_edepNonIontruth.push_back(ah.edepNonIon);
     m_edepInvtruth.push_back(ah.edepInv);
@@ -584,9 +1359,9 @@ void CaloTree::accumulateHits(CaloHit ah)
   //   ROD;
   if (id.type() == 1)
   {
-    int t = id.getTkey();
+    CaloKey t = id.getTkey();
     rtHits[t] = rtHits[t] + ah.edep;
-    int z = id.getZkey();
+    CaloKey z = id.getZkey();
     rzHits[z] = rzHits[z] + ah.edep;
     rzEdep[z] = rzEdep[z] + ah.edep;
   }
@@ -594,10 +1369,10 @@ void CaloTree::accumulateHits(CaloHit ah)
   //   S-Fibers
   if (id.type() == 2)
   {
-    int t = id.getTkey();
+    CaloKey t = id.getTkey();
     // int t=2;
     stHits[t] = stHits[t] + ah.edepbirk;
-    int z = id.getZkey();
+    CaloKey z = id.getZkey();
     // int z=12;
     szHits[z] = szHits[z] + ah.edepbirk;
     szEdep[z] = szEdep[z] + ah.edep;
@@ -606,10 +1381,10 @@ void CaloTree::accumulateHits(CaloHit ah)
   //   C-Fibers
   if (id.type() == 3)
   {
-    int t = id.getTkey();
+    CaloKey t = id.getTkey();
     // t=3;
     ctHits[t] = ctHits[t] + ah.ncercap;
-    int z = id.getZkey();
+    CaloKey z = id.getZkey();
     // cout<<"skdebug-  caloTrr accum  z="<<z<<"    iz "<<z/100000<<endl;;
     //  z=13;
     czHits[z] = czHits[z] + ah.ncercap;
@@ -627,6 +1402,35 @@ void CaloTree::accumulateHits(CaloHit ah)
   // mHepPy.clear();     // GeV
 }
 
+// ########################################################################
+void CaloTree::fillCompactTruth()
+{
+  for (auto itr = truthDeposits.begin(); itr != truthDeposits.end(); itr++)
+  {
+    const TruthDeposit &d = itr->second;
+    m_pidtruth.push_back(d.pid);
+    m_trackidtruth.push_back(d.trackid);
+    m_calotypetruth.push_back(d.calotype);
+    pushColumn(m_xtruth, m_xtruthF, compactSchema, d.wx / d.edep);
+    pushColumn(m_ytruth, m_ytruthF, compactSchema, d.wy / d.edep);
+    pushColumn(m_ztruth, m_ztruthF, compactSchema, d.wz / d.edep);
+    pushColumn(m_steplengthtruth, m_steplengthtruthF, compactSchema, d.wsteplength / d.edep);
+    pushColumn(m_globaltimetruth, m_globaltimetruthF, compactSchema, d.wglobaltime / d.edep);
+    pushColumn(m_localtimetruth, m_localtimetruthF, compactSchema, d.wlocaltime / d.edep);
+    m_edeptruth.push_back(d.edep);
+    m_edepNonIontruth.push_back(d.edepNonIon);
+    m_edepInvtruth.push_back(d.edepInv);
+    m_edepbirktruth.push_back(d.edepbirk);
+    m_ncertruth.push_back(d.ncer);
+    m_ncercaptruth.push_back(d.ncercap);
+    m_layerNumber.push_back(d.layerNumber);
+    m_rodNumber.push_back(d.rodNumber);
+    m_fiberNumber.push_back(d.fiberNumber);
+    m_nstepstruth.push_back(d.nsteps);
+  }
+}
+
+// ########################################################################
 void CaloTree::accumulateEnergy(double edep, int type = 0)
 {
   if (type == -99)
@@ -661,13 +1465,15 @@ void CaloTree::analyze()
   double edepS54 = 0.0; //  edeo sum in scintillating fibers
   double edepC54 = 0.0; //  edep sum in cherenkov fiberss
 
-  vector<double> edepRz(512, 0.0); //  size 256,  initial value 0.0
-  vector<double> edepSz(512, 0.0); //  size 256,  initial value 0.0
-  vector<double> edepCz(512, 0.0); //  size 256,  initial value 0.0
+  // slices beyond the last entry are summed into it (histograms stop at 250).
+  const int nSliceHist = 512;
+  vector<double> edepRz(nSliceHist, 0.0); //  size 512,  initial value 0.0
+  vector<double> edepSz(nSliceHist, 0.0); //  size 512,  initial value 0.0
+  vector<double> edepCz(nSliceHist, 0.0); //  size 512,  initial value 0.0
 
-  vector<double> ncerCz(512, 0.0);      //  size 256,  initial value 0.0
-  vector<double> ncerCt(512, 0.0);      //  size 256,  initial value 0.0
-  vector<double> ncerCtTower(512, 0.0); //  size 256,  initial value 0.0
+  vector<double> ncerCz(nSliceHist, 0.0);      //  size 512,  initial value 0.0
+  vector<double> ncerCt(nSliceHist, 0.0);      //  size 512,  initial value 0.0
+  vector<double> ncerCtTower(nSliceHist, 0.0); //  size 512,  initial value 0.0
 
   int n = 0;
 
@@ -678,7 +1484,7 @@ void CaloTree::analyze()
     ixitr++;
     CaloID id(itr->first);
     // id.print();
-    int zs = id.zslice();
+    int zs = min(id.zslice(), nSliceHist - 1);
     double edep = itr->second;
     edepR = edepR + edep;
     edepRz[zs] = edepRz[zs] + edep;
@@ -692,7 +1498,7 @@ void CaloTree::analyze()
   {
     CaloID id(itr->first);
     // id.print();
-    int zs = id.zslice();
+    int zs = min(id.zslice(), nSliceHist - 1);
     double edep = itr->second;
     edepS = edepS + edep;
     edepSz[zs] = edepSz[zs] + edep;
@@ -706,7 +1512,7 @@ void CaloTree::analyze()
   {
     CaloID id(itr->first);
     // id.print();
-    int zs = id.zslice();
+    int zs = min(id.zslice(), nSliceHist - 1);
     double edep = itr->second;
     edepC = edepC + edep;
     edepCz[zs] = edepCz[zs] + edep;
@@ -750,7 +1556,7 @@ void CaloTree::analyze()
     // std::cout<<" rt-key "<<itr->first<<"  val "<<itr->second<<std::endl;
     CaloID id(itr->first);
     // id.print();
-    int zs = id.zslice();
+    int zs = min(id.zslice(), nSliceHist - 1);
     // std::cout<<" Zslize ZHits: "<<zs<<std::endl;
     double ncer = itr->second;
     // cout<<"  zs="<<zs<<"   ncer="<<ncer<<endl;
@@ -776,7 +1582,7 @@ void CaloTree::analyze()
     // std::cout<<" rt-key "<<itr->first<<"  val "<<itr->second<<std::endl;
     CaloID id(itr->first);
     // id.print();
-    int ts = id.tslice();
+    int ts = min(id.tslice(), nSliceHist - 1);
     double ncer = itr->second;
     ncerCsumT = ncerCsumT + ncer;
     ncerCt[ts] = ncerCt[ts] + ncer;
@@ -814,12 +1620,12 @@ void CaloTree::analyze()
 
   /*    no csv file creation
    if(eventCountsALL<=getParamI("csvHits2dSC")) {
-      map<int,double> hits2dSC=make2Dhits(szHits);
+      HitMap hits2dSC=make2Dhits(szHits);
       writeCSV("2dSC",hits2dSC);
    }
 
    if(eventCountsALL<=getParamI("csvHits2dCH")) {
-      map<int,double> hits2dCH=make2Dhits(ctHits);
+      HitMap hits2dCH=make2Dhits(ctHits);
       writeCSV("2dCH",hits2dCH);
    }
 
@@ -830,18 +1636,19 @@ void CaloTree::analyze()
 }
 
 //  =============================================================================
-map<int, double> CaloTree::make2Dhits(map<int, double> hits)
+HitMap CaloTree::make2Dhits(const HitMap &hits)
 {
   // this produces 2D hits from 3d hits
-  map<int, double> hits2d;
+  HitMap hits2d(&eventArena);
+
+  // drop the slice index, keep channel and ztype bits (see CaloIDLayout)
+  const CaloKey mask = CaloIDLayout::lowMask(CaloIDLayout::kIz);
 
   for (auto itr = hits.begin(); itr != hits.end(); itr++)
   {
     // std::cout<<" rt-key "<<itr->first<<"  val "<<itr->second<<std::endl;
-    int k = itr->first;
-    int mask =
-        (1 << 22) - 1; // assuming bit pattern {2,2,5,5,3,3,2,8} (see CaloID)
-    int newkey = k & mask;
+    CaloKey k = itr->first;
+    CaloKey newkey = k & mask;
     double val = itr->second;
 
     hits2d[newkey] = hits2d[newkey] + val;
@@ -895,7 +1702,7 @@ void CaloTree::defineCSV(string type)
 }
 
 //  =============================================================================
-void CaloTree::writeCSV(string type, map<int, double> &hits)
+void CaloTree::writeCSV(string type, HitMap &hits)
 {
   //  type: "2dSC", "2dCH", "3dCH"
 
@@ -926,7 +1733,7 @@ void CaloTree::writeCSV(string type, map<int, double> &hits)
 
   for (const auto &n : hits)
   { // using C__11 definition
-    int key = n.first;
+    CaloKey key = n.first;
     CaloID id = CaloID(key);
     int ix = id.ix();
     int iy = id.iy();
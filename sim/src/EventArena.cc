@@ -0,0 +1,73 @@
+#include "EventArena.h"
+
+#include <algorithm> // for std::max
+#include <new>
+
+EventArena::EventArena()
+    : retained{nullptr, 0, 0}, usedBytes(0), peakUsedBytes(0), nOverflowEvents(0)
+{
+}
+
+EventArena::~EventArena()
+{
+   reset();
+   ::operator delete(retained.data);
+}
+
+// ------------------------------------------------------------------------------------
+void EventArena::setRetainedSize(std::size_t bytes)
+{
+   reset();
+   ::operator delete(retained.data);
+   retained.data = (bytes > 0) ? static_cast<char *>(::operator new(bytes)) : nullptr;
+   retained.size = bytes;
+   retained.offset = 0;
+}
+
+// ------------------------------------------------------------------------------------
+void EventArena::reset()
+{
+   if (!overflow.empty())
+      nOverflowEvents++;
+   for (auto &c : overflow)
+      ::operator delete(c.data);
+   overflow.clear();
+   retained.offset = 0;
+   usedBytes = 0;
+}
+
+// ------------------------------------------------------------------------------------
+void *EventArena::allocateFrom(Chunk &c, std::size_t bytes, std::size_t alignment)
+{
+   std::size_t start = (c.offset + alignment - 1) & ~(alignment - 1);
+   if (c.data == nullptr || start + bytes > c.size)
+      return nullptr;
+   c.offset = start + bytes;
+   return c.data + start;
+}
+
+// ------------------------------------------------------------------------------------
+void EventArena::addChunk(std::size_t minBytes)
+{
+   //  overflow chunks double in size, starting at 1 MB.
+   std::size_t last = overflow.empty() ? (std::size_t(1) << 20) : overflow.back().size * 2;
+   std::size_t size = std::max(last, minBytes);
+   overflow.push_back({static_cast<char *>(::operator new(size)), size, 0});
+}
+
+// ------------------------------------------------------------------------------------
+void *EventArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+   void *p = allocateFrom(retained, bytes, alignment);
+   if (p == nullptr && !overflow.empty())
+      p = allocateFrom(overflow.back(), bytes, alignment);
+   if (p == nullptr)
+   {
+      // operator new returns memory aligned for any fundamental type.
+      addChunk(bytes + alignment);
+      p = allocateFrom(overflow.back(), bytes, alignment);
+   }
+   usedBytes += bytes;
+   peakUsedBytes = std::max(peakUsedBytes, usedBytes);
+   return p;
+}
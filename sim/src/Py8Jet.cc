@@ -4,6 +4,8 @@
 #include <TStyle.h>
 #include <TCanvas.h>
 
+#include <fstream>
+
 void Py8Jet::Loop()
 {
    //   In a ROOT session, you can do:
@@ -45,3 +47,86 @@ void Py8Jet::Loop()
       // if (Cut(ientry) < 0) continue;
    }
 }
+
+namespace
+{
+   // branches of GetEntry after SelectBranches
+   const char *usedBranches[] = {"run", "event", "nparticles", "pid", "daughter1", "px", "py", "pz"};
+}
+
+// -----------------------------------------------------------------------------
+Int_t Py8Jet::AddFiles(TChain *chain, const std::string &files)
+{
+   // comma separated file names or globs ("dir/py8_*.root"), or a text
+   // file (.txt, .list) with one name or glob per line.
+   Int_t nFiles = 0;
+   size_t pos = 0;
+   while (pos <= files.size())
+   {
+      size_t end = files.find(',', pos);
+      if (end == std::string::npos)
+         end = files.size();
+      std::string name = files.substr(pos, end - pos);
+      pos = end + 1;
+      if (name.empty())
+         continue;
+      bool isList = (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0) ||
+                    (name.size() > 5 && name.compare(name.size() - 5, 5, ".list") == 0);
+      if (!isList)
+      {
+         nFiles += chain->Add(name.c_str());
+         continue;
+      }
+      std::ifstream in(name);
+      std::string line;
+      while (std::getline(in, line))
+      {
+         line = line.substr(0, line.find('#'));
+         line.erase(0, line.find_first_not_of(" \t"));
+         line.erase(line.find_last_not_of(" \t\r") + 1);
+         if (!line.empty())
+            nFiles += chain->Add(line.c_str());
+      }
+   }
+   return nFiles;
+}
+
+// -----------------------------------------------------------------------------
+void Py8Jet::SelectBranches()
+{
+   // the generator uses the final state only: pid, daughter1 and the
+   // momentum.  status, mothers, colors, e and m are read by ReadAll.
+   if (!fChain)
+      return;
+   fChain->SetBranchStatus("*", 0);
+   for (auto name : usedBranches)
+      fChain->SetBranchStatus(name, 1);
+}
+
+// -----------------------------------------------------------------------------
+void Py8Jet::SetCache(Long64_t bytes, Long64_t firstEntry)
+{
+   // TTreeCache over the branches of SelectBranches, from the first entry
+   // read on.
+   // Asynchronous read-ahead (TFile.AsyncPrefetching) must be enabled
+   // before the files are opened.
+   if (!fChain || bytes <= 0)
+      return;
+   fChain->SetCacheSize(bytes);
+   fChain->SetCacheEntryRange(firstEntry, fChain->GetEntriesFast());
+   for (auto name : usedBranches)
+      fChain->AddBranchToCache(name, kFALSE);
+   fChain->StopCacheLearningPhase();
+}
+
+// -----------------------------------------------------------------------------
+void Py8Jet::ReadAll()
+{
+   if (!fChain || !fChain->GetTree())
+      return;
+   Long64_t ientry = fChain->GetTree()->GetReadEntry();
+   TBranch *others[] = {b_status, b_mother1, b_mother2, b_daughter2, b_color1, b_color2, b_e, b_m};
+   for (auto b : others)
+      if (b)
+         b->GetEntry(ientry, 1); // getall: also if the branch is inactive
+}
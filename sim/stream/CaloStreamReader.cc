@@ -0,0 +1,75 @@
+#include "CaloStreamReader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ------------------------------------------------------------------
+CaloStreamReader::CaloStreamReader(std::string socketPath, int waitSeconds) : fd(-1)
+{
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+  for (int i = 0; i <= waitSeconds; i++)
+  {
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0)
+      return;
+    ::close(fd);
+    fd = -1;
+    if (i < waitSeconds)
+      ::sleep(1);
+  }
+  std::cerr << "CaloStreamReader: can not connect to " << socketPath << ": " << std::strerror(errno)
+            << std::endl;
+}
+
+// ------------------------------------------------------------------
+CaloStreamReader::~CaloStreamReader()
+{
+  if (fd >= 0)
+    ::close(fd);
+}
+
+// ------------------------------------------------------------------
+bool CaloStreamReader::readAll(void *buf, size_t n)
+{
+  char *p = (char *)buf;
+  while (n > 0)
+  {
+    ssize_t k = ::recv(fd, p, n, 0);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+// ------------------------------------------------------------------
+bool CaloStreamReader::next(CaloStreamEvent &ev)
+{
+  if (fd < 0 || !readAll(&ev.header, sizeof(ev.header)))
+    return false;
+  const CaloStreamHeader &h = ev.header;
+  if (h.magic != CaloStream::kMagic || h.version != CaloStream::kVersion || h.headerSize != sizeof(CaloStreamHeader))
+  {
+    std::cerr << "CaloStreamReader: bad record header (version " << h.version << ")" << std::endl;
+    return false;
+  }
+
+  ev.ss.resize(h.nSS);
+  ev.cc.resize(h.nCC);
+  ev.image.resize(size_t(h.imageNx) * h.imageNy);
+  return readAll(ev.ss.data(), ev.ss.size() * sizeof(CaloStreamChannel)) &&
+         readAll(ev.cc.data(), ev.cc.size() * sizeof(CaloStreamChannel)) &&
+         readAll(ev.image.data(), ev.image.size() * sizeof(float));
+}
@@ -0,0 +1,40 @@
+#ifndef CaloStreamReader_h
+#define CaloStreamReader_h 1
+
+#include <string>
+#include <vector>
+
+#include "CaloStreamRecord.h"
+
+// one event received from the simulation (see CaloStreamRecord.h).
+struct CaloStreamEvent
+{
+  CaloStreamHeader header;
+  std::vector<CaloStreamChannel> ss;
+  std::vector<CaloStreamChannel> cc;
+  std::vector<float> image; // [iy][ix], empty without image
+};
+
+// consumer side of the stream output: connects to the socket of a running
+// exampleB4b (streamSocket) and reads its events as they finish.
+//
+//   CaloStreamReader reader("/tmp/calox.sock");
+//   CaloStreamEvent ev;
+//   while (reader.next(ev)) { ... }
+class CaloStreamReader
+{
+public:
+  // waits up to waitSeconds for the simulation to open the socket.
+  CaloStreamReader(std::string socketPath, int waitSeconds = 60);
+  ~CaloStreamReader();
+
+  bool isConnected() const { return fd >= 0; }
+  bool next(CaloStreamEvent &ev); // false at the end of the stream
+
+private:
+  bool readAll(void *buf, size_t n);
+
+  int fd;
+};
+
+#endif
@@ -0,0 +1,31 @@
+// print the events published by a running exampleB4b with streamOutput true.
+//   ./streamDump /tmp/calox.sock [maxEvents]
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+
+#include "CaloStreamReader.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    std::cout << "usage: " << argv[0] << " socketPath [maxEvents]" << std::endl;
+    return 1;
+  }
+  long maxEvents = argc > 2 ? std::atol(argv[2]) : -1;
+
+  CaloStreamReader reader(argv[1]);
+  CaloStreamEvent ev;
+  long n = 0;
+  while ((maxEvents < 0 || n < maxEvents) && reader.next(ev))
+  {
+    float image = std::accumulate(ev.image.begin(), ev.image.end(), 0.0f);
+    std::cout << "event " << ev.header.event << "  beamID " << ev.header.beamID
+              << "  beamE " << ev.header.beamE << "  nSS " << ev.header.nSS << "  nCC " << ev.header.nCC
+              << "  image " << ev.header.imageNy << "x" << ev.header.imageNx << " sum " << image << std::endl;
+    n++;
+  }
+  std::cout << n << " events read" << std::endl;
+  return 0;
+}
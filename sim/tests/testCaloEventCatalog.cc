@@ -0,0 +1,128 @@
+// catalogs of writers killed between flushes (fork, _exit without close):
+// readable up to the last flush, with the right file names, also after
+// the file table moved and when a resumed catalog is interrupted.  Exits 1
+// on the first failure.
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CaloEventCatalog.h"
+
+namespace
+{
+  const std::string path = "testCaloEventCatalog.cxc";
+
+  CaloCatalogRecord record(long i, int file)
+  {
+    CaloCatalogRecord rec = {};
+    rec.entry = i;
+    rec.file = file;
+    rec.run = 1;
+    rec.event = int(i);
+    rec.seeds[0] = 3 * i;
+    rec.seeds[1] = 7 * i + 1;
+    rec.beamE = float(i);
+    return rec;
+  }
+
+  std::string fileName(int i) { return "out/mc_test_run1_" + std::to_string(i) + "_Test_10evt_pi+_1_1.root"; }
+
+  // files of nFiles flushes of perFile events each, then `more` events
+  // after the last flush
+  void fill(CaloCatalogWriter &writer, int nFiles, long perFile, long more)
+  {
+    for (int f = 0; f < nFiles; f++)
+    {
+      int file = writer.addFile(fileName(writer.fileCount()));
+      for (long i = 0; i < perFile; i++)
+        writer.add(record(writer.size(), file));
+      writer.flush();
+    }
+    for (long i = 0; i < more; i++)
+      writer.add(record(writer.size(), writer.fileCount() - 1));
+  }
+
+  // job(writer) in a child that exits without closing the catalog;
+  // keep: events and files of the catalog to continue, -1: a new one
+  template <class Job> void interrupted(long keepEvents, int keepFiles, Job job)
+  {
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      CaloCatalogWriter *writer = keepEvents < 0 ? new CaloCatalogWriter(path)
+                                                 : new CaloCatalogWriter(path, keepEvents, keepFiles);
+      job(*writer);
+      _exit(0); // no destructor: the catalog is not closed
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+  }
+
+  bool check(const char *what, long nEvents, int nFiles, long perFile)
+  {
+    CaloEventCatalog cat(path);
+    bool ok = cat.good() && cat.size() == nEvents && cat.nFiles() == nFiles;
+    for (int f = 0; ok && f < nFiles; f++)
+      ok = cat.file(f) == fileName(f);
+    CaloCatalogRecord rec;
+    for (long i = 0; ok && i < nEvents; i++)
+      ok = cat.get(i, rec) && rec.entry == i && rec.file == int(i / perFile) && rec.seeds[0] == 3 * i &&
+           rec.seeds[1] == 7 * i + 1;
+    if (!ok)
+      std::cout << "testCaloEventCatalog: " << what << ": expected " << nEvents << " events in " << nFiles
+                << " files, got good " << cat.good() << ", " << cat.size() << " events, " << cat.nFiles() << " files"
+                << (cat.nFiles() > 0 ? ", file(0) \"" + cat.file(0) + "\"" : std::string()) << std::endl;
+    return ok;
+  }
+
+  long fileSize()
+  {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? long(st.st_size) : -1;
+  }
+}
+
+int main()
+{
+  const long perFile = 1000;
+  bool ok = true;
+
+  // killed after the first flush
+  interrupted(-1, 0, [&](CaloCatalogWriter &writer) { fill(writer, 1, 3, 5); });
+  ok = ok && check("interrupted", 3, 1, 3);
+
+  // killed after the records passed the first table position
+  interrupted(-1, 0, [&](CaloCatalogWriter &writer) { fill(writer, 10, perFile, 500); });
+  ok = ok && check("interrupted after the table moved", 10 * perFile, 10, perFile);
+
+  // resumed from the last flush, killed again
+  interrupted(10 * perFile, 10, [&](CaloCatalogWriter &writer) { fill(writer, 3, perFile, 700); });
+  ok = ok && check("resumed and interrupted", 13 * perFile, 13, perFile);
+
+  // resumed and closed: compact, no free space left
+  {
+    CaloCatalogWriter writer(path, 13 * perFile, 13);
+    fill(writer, 2, perFile, 0);
+  }
+  ok = ok && check("resumed and closed", 15 * perFile, 15, perFile);
+  long table = 0;
+  for (int f = 0; f < 15; f++)
+    table += fileName(f).size() + 1;
+  long expected = sizeof(CaloCatalogHeader) + 15 * perFile * sizeof(CaloCatalogRecord) + table;
+  if (ok && fileSize() != expected)
+  {
+    std::cout << "testCaloEventCatalog: closed catalog has " << fileSize() << " bytes, expected " << expected
+              << std::endl;
+    ok = false;
+  }
+
+  std::remove(path.c_str());
+  if (!ok)
+    return 1;
+  std::cout << "testCaloEventCatalog: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,118 @@
+// round trip of every valid CaloKey field tuple through packKey and
+// CaloID(CaloKey): fields must not overlap or lose bits.  Also the SiPM
+// areas of the full module, for several channel grids, and of small
+// modules.  Exits 1 on the first mismatch.
+#include <cstdlib>
+#include <iostream>
+
+#include "CaloID.h"
+
+using namespace CaloIDLayout;
+
+namespace
+{
+   long nChecked = 0;
+
+   bool check(int type, int area, int ix, int iy, int ixx, int iyy, int ztype, int iz)
+   {
+      nChecked++;
+      CaloID id(CaloID::packKey(type, area, ix, iy, ixx, iyy, ztype, iz));
+      bool ok = id.type() == type && id.area() == area && id.ix() == ix && id.iy() == iy && id.ixx() == ixx &&
+                id.iyy() == iyy && id.zslice() == (ztype == 1 ? iz : 0) && id.tslice() == (ztype == 2 ? iz : 0);
+      if (!ok)
+      {
+         std::cout << "testCaloID: mismatch for type " << type << " area " << area << " ix " << ix << " iy " << iy
+                   << " ixx " << ixx << " iyy " << iyy << " ztype " << ztype << " iz " << iz << ", got ";
+         id.print();
+      }
+      return ok;
+   }
+
+   // SiPM area of a rod of the full module (90 x 80 rods, 3 x 4 rods per SiPM)
+   int sipmArea(int rod, int layer)
+   {
+      int sx = rod / 3, sy = layer / 4;
+      int a = (sx > 4 && sx < 25 && sy > 1 && sy < 18) ? 2 : 0;
+      if (sx > 12 && sx < 17)
+      {
+         if (sy > 17 || sy < 3)
+            a = 2;
+         if (sy > 7 && sy < 12)
+            a = 3;
+      }
+      return a;
+   }
+
+   // 30 x 20 rods (10 x 5 SiPMs): edge columns 0-1 and 8-9, rows 0 and 4
+   // without SiPMs, except the centre column 5 with a 3 mm SiPM in row 2
+   int smallArea(int rod, int layer)
+   {
+      int sx = rod / 3, sy = layer / 4;
+      if (sx == 5)
+         return sy == 2 ? 3 : 2;
+      return (sx > 1 && sx < 8 && sy > 0 && sy < 4) ? 2 : 0;
+   }
+
+   // the 9 x 9 rods of paramBatch03_mini.mac (3 x 3 SiPMs): a 3 mm SiPM in
+   // the centre, the side columns without SiPMs
+   int miniArea(int rod, int layer)
+   {
+      int sx = rod / 3, sy = layer / 4;
+      if (sx != 1)
+         return 0;
+      return sy == 1 ? 3 : 2;
+   }
+
+   bool checkAreas(int nRods, int nLayers, int rodsPerChannel, int layersPerChannel, int (*expected)(int, int))
+   {
+      CaloID::setGeometry(nRods, nLayers, 2000.0, rodsPerChannel, layersPerChannel, 20.0);
+      for (int rod = 0; rod < nRods; rod++)
+         for (int layer = 0; layer < nLayers; layer++)
+         {
+            CaloID id(1, 0, layer, rod, 0.0, 0.0);
+            if (id.area() != expected(rod, layer))
+            {
+               std::cout << "testCaloID: rod " << rod << " layer " << layer << " of " << nRods << " x " << nLayers
+                         << " in " << rodsPerChannel << " x " << layersPerChannel << " channels: area " << id.area()
+                         << ", expected " << expected(rod, layer) << std::endl;
+               return false;
+            }
+         }
+      return true;
+   }
+}
+
+int main()
+{
+   // every value of the small fields; iz varies along the loop over its
+   // whole range (multiplicative hash), its edges are looped over below.
+   unsigned long n = 0;
+   for (int type = 0; type <= maxValue(kType); type++)
+      for (int area = 0; area <= maxValue(kArea); area++)
+         for (int ix = 0; ix <= maxValue(kIx); ix++)
+            for (int iy = 0; iy <= maxValue(kIy); iy++)
+               for (int ixx = 0; ixx <= maxValue(kIxx); ixx++)
+                  for (int iyy = 0; iyy <= maxValue(kIyy); iyy++)
+                     for (int ztype = 0; ztype <= maxValue(kZtype); ztype++)
+                     {
+                        int iz = int((n++ * 2654435761ul) & mask(kIz));
+                        if (!check(type, area, ix, iy, ixx, iyy, ztype, iz))
+                           return 1;
+                     }
+
+   // every slice, next to the largest values of the other fields
+   for (int iz = 0; iz <= maxValue(kIz); iz++)
+      for (int ztype = 1; ztype <= 2; ztype++)
+         if (!check(maxValue(kType), maxValue(kArea), maxValue(kIx), maxValue(kIy), maxValue(kIxx), maxValue(kIyy),
+                    ztype, iz))
+            return 1;
+
+   if (!checkAreas(90, 80, 3, 4, sipmArea) || !checkAreas(90, 80, 1, 1, sipmArea) ||
+       !checkAreas(90, 80, 6, 8, sipmArea))
+      return 1;
+   if (!checkAreas(30, 20, 3, 4, smallArea) || !checkAreas(9, 9, 1, 1, miniArea))
+      return 1;
+
+   std::cout << "testCaloID: " << nChecked << " keys OK, areas OK" << std::endl;
+   return 0;
+}
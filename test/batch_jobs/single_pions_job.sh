@@ -2,11 +2,8 @@
 
 source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup.sh
 
-SRC_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/src"
 OUTER_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/test"
 BUILD_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim"
-STEPPING_FILE="B4bSteppingAction.cc"
-PARAMBATCH_FILE="paramBatch03_single.mac"
 LUSTRE_DIR="/fs/ddn/sdf/group/atlas/d/liangyu/dSiPM/single_pions"
 
 echo "Starting scanning..."
@@ -19,26 +16,11 @@ GUN_ENERGY_MAX=5
 PARTICLE_NAME="pi-"
 
 
-INCIDENT_ANGLE=15
-ANGLE_RAD=$(echo "$INCIDENT_ANGLE * 3.14159265359 / 180" | bc -l)
-MOMENTUM_X=$(echo "s($ANGLE_RAD)" | bc -l)
-MOMENTUM_Y="0.0"
-MOMENTUM_Z=$(echo "c($ANGLE_RAD)" | bc -l)
+INCIDENT_ANGLE=15 # degree in x-z, passed to the gun as -beamAngleX
 
 
     
-cd $SRC_DIR
-# sed -i "822s/.*/  if (!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber < 35 || rodNumber > 55 || layerNumber < 32 || layerNumber > 50)/" $STEPPING_FILE
-sed -i "822s/.*/  if (!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber < 20 || rodNumber > 60 || layerNumber < 15 || layerNumber > 65)/" $STEPPING_FILE
-echo "$STEPPING_FILE 822 line gets modified!"
-
 cd $BUILD_DIR
-sed -i "23s/.*/\\#\\$\\$\\$ pMomentum_x      $MOMENTUM_X/" $PARAMBATCH_FILE
-sed -i "24s/.*/\\#\\$\\$\\$ pMomentum_y      $MOMENTUM_Y/" $PARAMBATCH_FILE
-sed -i "25s/.*/\\#\\$\\$\\$ pMomentum_z      $MOMENTUM_Z/" $PARAMBATCH_FILE
-echo "Modified momentum direction in $PARAMBATCH_FILE to angle $INCIDENT_ANGLE degrees"
-echo "Setting particle momentum direction: ($MOMENTUM_X, $MOMENTUM_Y, $MOMENTUM_Z)"
-
 TEMP_SCRIPT=$(mktemp)
 cat > $TEMP_SCRIPT << EOF
 #!/bin/bash
@@ -70,7 +52,7 @@ for ((job_id=1; job_id<=NUM_JOBS; job_id++)); do
 #!/bin/bash
 source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup9.sh
 cd /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/build
-./exampleB4b -b paramBatch03_single.mac -jobName ${PARTICLE_NAME}_job -runNumber 1 -runSeq ${job_id} -numberOfEvents ${EVENTS_PER_JOB} -eventsInNtupe 100 -gun_particle ${PARTICLE_NAME} -gun_energy_min ${GUN_ENERGY_MIN} -gun_energy_max ${GUN_ENERGY_MAX} -sipmType 1
+./exampleB4b -b paramBatch03_single.mac -jobName ${PARTICLE_NAME}_job -runNumber 1 -runSeq ${job_id} -numberOfEvents ${EVENTS_PER_JOB} -eventsInNtupe 100 -gun_particle ${PARTICLE_NAME} -gun_energy_min ${GUN_ENERGY_MIN} -gun_energy_max ${GUN_ENERGY_MAX} -beamAngleX ${INCIDENT_ANGLE} -sipmType 1 -opWindow 20:60,15:65
 echo "Job ${job_id} for energy=${GUN_ENERGY_MIN}GeV completed!"
 EOF
   
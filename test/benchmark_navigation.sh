@@ -0,0 +1,26 @@
+#!/bin/bash
+# step rates of the two lattice representations (geometryNavigation):
+# showers with paramBatch03_single.mac and optical photon transport with
+# paramBatch03_single_photon.mac, same seeds for both.
+#
+#   ./benchmark_navigation.sh <build dir with exampleB4b> [events] [energy GeV]
+
+BUILD_DIR=${1:-../sim/build}
+EVENTS=${2:-10}
+ENERGY=${3:-20.0}
+
+cd $BUILD_DIR || exit 1
+
+printf "%-28s %-14s %10s %10s %12s\n" "macro" "navigation" "steps" "optical" "steps/s"
+for MAC in paramBatch03_single.mac paramBatch03_single_photon.mac; do
+  for NAV in replica parameterised; do
+    LOG=bench_${NAV}_${MAC%.mac}.log
+    ./exampleB4b -b $MAC -jobName bench -runNumber 1 -runSeq 1 \
+      -numberOfEvents $EVENTS -eventsInNtupe 0 \
+      -gun_particle e+ -gun_energy_min $ENERGY -gun_energy_max $ENERGY \
+      -geometryNavigation $NAV > $LOG 2>&1
+    # B4bRunAction: <n> steps (<m> optical photon) in <t> s, <r> steps/s, ...
+    grep "^B4bRunAction: .* steps/s" $LOG | tail -1 | \
+      awk -v mac=${MAC%.mac} -v nav=$NAV '{gsub(/\(/,"",$4); printf "%-28s %-14s %10s %10s %12.0f\n", mac, nav, $2, $4, $10}'
+  done
+done
@@ -2,10 +2,8 @@
 
 source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup.sh
 
-SRC_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/src"
 OUTER_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/test"
 BUILD_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim"
-STEPPING_FILE="B4bSteppingAction.cc"
 LUSTRE_DIR="/fs/ddn/sdf/group/atlas/d/liangyu/dSiPM/cs231n"
 
 echo "Starting scanning..."
@@ -19,11 +17,6 @@ PARTICLE_NAME="e-"
 
 
     
-cd $SRC_DIR
-# sed -i "822s/.*/  if (!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber < 35 || rodNumber > 55 || layerNumber < 32 || layerNumber > 50)/" $STEPPING_FILE
-sed -i "822s/.*/  if (!(isCoreS || isCoreC || isCladS || isCladC) || rodNumber < 20 || rodNumber > 60 || layerNumber < 15 || layerNumber > 65)/" $STEPPING_FILE
-echo "$STEPPING_FILE 822 line gets modified!"
-
 TEMP_SCRIPT=$(mktemp)
 cat > $TEMP_SCRIPT << EOF
 #!/bin/bash
@@ -55,7 +48,7 @@ for ((job_id=1; job_id<=NUM_JOBS; job_id++)); do
 #!/bin/bash
 source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup9.sh
 cd /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/build
-./exampleB4b -b paramBatch03_single.mac -jobName ${PARTICLE_NAME}_job -runNumber 1 -runSeq ${job_id} -numberOfEvents ${EVENTS_PER_JOB} -eventsInNtupe 100 -gun_particle ${PARTICLE_NAME} -gun_energy_min ${GUN_ENERGY_MIN} -gun_energy_max ${GUN_ENERGY_MAX} -sipmType 1
+./exampleB4b -b paramBatch03_single.mac -jobName ${PARTICLE_NAME}_job -runNumber 1 -runSeq ${job_id} -numberOfEvents ${EVENTS_PER_JOB} -eventsInNtupe 100 -gun_particle ${PARTICLE_NAME} -gun_energy_min ${GUN_ENERGY_MIN} -gun_energy_max ${GUN_ENERGY_MAX} -sipmType 1 -opWindow 20:60,15:65
 echo "Job ${job_id} for energy=${GUN_ENERGY_MIN}GeV completed!"
 EOF
   
@@ -0,0 +1,81 @@
+#!/bin/bash
+# -replayEvent with a small photonBudgetMB: the replayed event is past
+# eventsInNtupe, but it is written, so all its spilled chunks must be in
+# opspill and its photon count must match the event of the full job.
+#
+#   ./replay_photon_budget.sh <build dir with exampleB4b> [event] [energy GeV]
+
+BUILD_DIR=${1:-../sim/build}
+EVENT=${2:-3}
+ENERGY=${3:-10.0}
+
+cd $BUILD_DIR || exit 1
+
+OPTS="-b paramBatch03_single_photon.mac -jobName replaytest -runNumber 1 -runSeq 1 \
+  -numberOfEvents $EVENT -gun_particle e+ -gun_energy_min $ENERGY -gun_energy_max $ENERGY \
+  -eventSeeding event -photonBudgetMB 1 -outputShardEvents 0 -eventCatalog false"
+
+./exampleB4b $OPTS -eventsInNtupe $EVENT > replaytest_job.log 2>&1 || exit 1
+./exampleB4b $OPTS -eventsInNtupe 1 -replayEvent $EVENT > replaytest_replay.log 2>&1 || exit 1
+
+JOB=$(ls -t mc_replaytest_run1_1_*.root | grep -v _replay | head -1)
+REPLAY=$(ls -t mc_replaytest_run1_1_*_replay${EVENT}.root | head -1)
+
+cat > replaytest_check.C << EOF
+// photons of event $EVENT: tree (nOPs + nOPspilled) and opspill (chunks)
+long photons(const char *file, int &chunks, long &spilled)
+{
+  TFile *f = TFile::Open(file);
+  TTree *t = f->Get<TTree>("tree");
+  TTree *s = f->Get<TTree>("opspill");
+  int event, nOPs, nOPspilled;
+  t->SetBranchAddress("event", &event);
+  t->SetBranchAddress("nOPs", &nOPs);
+  t->SetBranchAddress("nOPspilled", &nOPspilled);
+  t->SetBranchAddress("nOPchunks", &chunks);
+  long total = -1;
+  for (long i = 0; i < t->GetEntries(); i++)
+  {
+    t->GetEntry(i);
+    if (event == $EVENT)
+      total = long(nOPs) + nOPspilled;
+  }
+  spilled = 0;
+  int written = 0;
+  if (s)
+  {
+    s->SetBranchAddress("event", &event);
+    s->SetBranchAddress("nOPs", &nOPs);
+    for (long i = 0; i < s->GetEntries(); i++)
+    {
+      s->GetEntry(i);
+      if (event == $EVENT)
+      {
+        written++;
+        spilled += nOPs;
+      }
+    }
+  }
+  if (written != chunks)
+    cout << file << ": nOPchunks " << chunks << ", " << written << " chunks in opspill" << endl;
+  chunks = written == chunks ? chunks : -1;
+  f->Close();
+  return total;
+}
+
+int replaytest_check()
+{
+  int jobChunks, replayChunks;
+  long jobSpilled, replaySpilled;
+  long job = photons("$JOB", jobChunks, jobSpilled);
+  long replay = photons("$REPLAY", replayChunks, replaySpilled);
+  cout << "event $EVENT: job " << job << " photons, " << jobChunks << " chunks; replay " << replay
+       << " photons, " << replayChunks << " chunks" << endl;
+  bool ok = job > 0 && replay == job && replayChunks > 0 && replayChunks == jobChunks && replaySpilled == jobSpilled;
+  cout << (ok ? "OK" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
+EOF
+
+root -l -b -q replaytest_check.C | tee replaytest_check.log
+grep -q "^OK" replaytest_check.log
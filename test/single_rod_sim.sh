@@ -2,15 +2,30 @@
 
 source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup.sh
 
-SRC_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/src"
 OUTER_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/test"
 BUILD_DIR="/sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim"
-STEPPING_FILE="B4bSteppingAction.cc"
 LUSTRE_DIR="/fs/ddn/sdf/group/atlas/d/liangyu/dSiPM"
 RESULTS_FILE="${OUTER_DIR}/simulation_results_new_4.txt"
 
 echo "Rod Layer Energy TotalEntries_Mean TotalEntries_RMS Above90Entries_Mean Above90Entries_RMS nOPs_Sum" > ${RESULTS_FILE}
 
+# one build for the scan, the rod and layer are passed as -opWindow
+TEMP_SCRIPT=$(mktemp)
+cat > $TEMP_SCRIPT << EOF
+#!/bin/bash
+rm -rf /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/build
+source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup9.sh
+cd $BUILD_DIR
+mkdir build
+cd build
+cmake ..
+make -j 4
+EOF
+chmod +x $TEMP_SCRIPT
+singularity exec --bind=/cvmfs,/sdf,/fs,/lscratch /cvmfs/atlas.cern.ch/repo/containers/fs/singularity/x86_64-almalinux9 $TEMP_SCRIPT
+rm $TEMP_SCRIPT
+echo "compiling completed!"
+
 echo "Starting scanning..."
 
 TOTAL_EVENTS=2000
@@ -22,7 +37,7 @@ PARTICLE_NAME="pi-"
 
 
 for a in $(seq 0 5 80); do
-  for b in $(seq 0 5 80); do
+  for b in $(seq 0 5 75); do # layers 0-79
   
     if ([ $a -lt 20 ] || ([ $a -eq 20 ] && [ $b -le 65 ])); then
       continue
@@ -30,27 +45,6 @@ for a in $(seq 0 5 80); do
 
     echo "========================================="
     echo "Setting rodNumber = $a, layerNumber = $b"
-    
-    cd $SRC_DIR
-    sed -i "822s/rodNumber != [0-9]* || layerNumber != [0-9]*/rodNumber != $a || layerNumber != $b/" $STEPPING_FILE
-    echo "$STEPPING_FILE 822 line gets modified!"
-
-    TEMP_SCRIPT=$(mktemp)
-    cat > $TEMP_SCRIPT << EOF
-#!/bin/bash
-rm -rf /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/build
-source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup9.sh
-cd $BUILD_DIR
-mkdir build
-cd build
-cmake ..
-make -j 4
-EOF
-    chmod +x $TEMP_SCRIPT
-    singularity exec --bind=/cvmfs,/sdf,/fs,/lscratch /cvmfs/atlas.cern.ch/repo/containers/fs/singularity/x86_64-almalinux9 $TEMP_SCRIPT
-    rm $TEMP_SCRIPT
-    
-    echo "rodNumber=$a, layerNumber=$b compiling completed!"
     echo "========================================="
 
     cd $OUTER_DIR
@@ -67,7 +61,7 @@ EOF
 #!/bin/bash
 source /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/setup9.sh
 cd /sdf/data/atlas/u/liangyu/dSiPM/DREAMSim/sim/build
-./exampleB4b -b paramBatch03_single.mac -jobName ${PARTICLE_NAME}_job_rod${a}_layer${b} -runNumber ${a} -runSeq ${job_id} -numberOfEvents ${EVENTS_PER_JOB} -eventsInNtupe 100 -gun_particle ${PARTICLE_NAME} -gun_energy_min ${GUN_ENERGY_MIN} -gun_energy_max ${GUN_ENERGY_MAX} -sipmType 1
+./exampleB4b -b paramBatch03_single.mac -jobName ${PARTICLE_NAME}_job_rod${a}_layer${b} -runNumber ${a} -runSeq ${job_id} -numberOfEvents ${EVENTS_PER_JOB} -eventsInNtupe 100 -gun_particle ${PARTICLE_NAME} -gun_energy_min ${GUN_ENERGY_MIN} -gun_energy_max ${GUN_ENERGY_MAX} -sipmType 1 -opWindow ${a}:${a},${b}:${b}
 echo "Job ${job_id} for rod=${a}, layer=${b}, energy=${GUN_ENERGY_MIN}GeV completed!"
 EOF
   